@@ -0,0 +1,82 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+using namespace std;
+
+#define TRIMWRIGHT_BUBBLE_CACHE 1
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+#define ROUNDS 4000000
+
+enum {
+    SIG_TICK = SIG_USER,
+};
+
+
+// Six levels, where SIG_TICK is only handled by the top state and every
+// state below passes it up.
+#define PASSING(name, parent) \
+        DispatchOutcome name(const Event* event) { \
+            if (SIG_TICK == event->signal) { \
+                return TW_PASS(parent); \
+            } \
+            return TW_SUPER(parent); \
+        }
+
+class Machine : public HSM {
+    public:
+        uint32_t ticks;
+
+        DispatchOutcome stateL1(const Event* event) {
+            if (SIG_TICK == event->signal) {
+                ticks++;
+                return TW_HANDLED();
+            }
+            return TW_SUPER(&Machine::stateROOT);
+        }
+        PASSING(stateL2, &Machine::stateL1)
+        PASSING(stateL3, &Machine::stateL2)
+        PASSING(stateL4, &Machine::stateL3)
+        PASSING(stateL5, &Machine::stateL4)
+        PASSING(stateL6, &Machine::stateL5)
+};
+
+
+double benchmark(const char* name, bool cached) {
+    Machine machine;
+    BubbleCache bubbles[1];
+    if (cached) {
+        machine.setBubbleCache(bubbles, 1);
+    }
+    machine.ticks = 0;
+    machine.init((State) &Machine::stateL6);
+    Event tick;
+    tick.signal = SIG_TICK;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        machine.dispatch(&tick);
+    }
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+
+    double ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count() / double(ROUNDS);
+    cout << name << ": " << ns << " ns/event (ticks " << machine.ticks << ")" << endl;
+    return ns;
+}
+
+
+int main(int argc, const char* argv[]) {
+    double plain = benchmark("handled 5 levels up", false);
+    double cached = benchmark("with a bubble cache", true);
+    cout << "speedup " << plain / cached << "x" << endl;
+}
+
+
+#endif
@@ -0,0 +1,122 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define EVENTS 2000000
+
+
+// a QueueRingBuffer shared with another thread, which takes the mutex for
+// every call (as the consumer needs to as well)
+class QueueLocked : public IQueue {
+    protected:
+        QueueRingBuffer<Event, 64>  m_queue;
+        mutex                       m_mutex;
+
+    public:
+        virtual void push_back(Event* event) {
+            lock_guard<mutex> lock(m_mutex);
+            m_queue.push_back(event);
+        }
+        virtual bool push_back(const Event* event, uint8_t size) {
+            lock_guard<mutex> lock(m_mutex);
+            return m_queue.push_back(event, size);
+        }
+        bool push(Event* event) {
+            lock_guard<mutex> lock(m_mutex);
+            if (m_queue.size() >= 64) {
+                return false;
+            }
+            m_queue.push_back(event);
+            return true;
+        }
+        virtual Event* front() {
+            lock_guard<mutex> lock(m_mutex);
+            return m_queue.front();
+        }
+        virtual void pop_front() {
+            lock_guard<mutex> lock(m_mutex);
+            m_queue.pop_front();
+        }
+        virtual uint8_t size() {
+            lock_guard<mutex> lock(m_mutex);
+            return m_queue.size();
+        }
+};
+
+
+class Counter : public FSM {
+    public:
+        uint32_t count;
+        DispatchOutcome stateCOUNTING(const Event* event) {
+            if (SIG_USER == event->signal) {
+                count++;
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+template <class Queue>
+void benchmark(const char* name) {
+    Queue queue;
+    Counter machine;
+    machine.count = 0;
+    machine.init((State) &Counter::stateCOUNTING);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    thread producer([&queue]() {
+        Event event;
+        event.signal = SIG_USER;
+        for (uint32_t e = 0; e < EVENTS; e++) {
+            while (! queue.push(&event)) {
+                this_thread::yield();
+            }
+        }
+    });
+    while (machine.count < EVENTS) {
+        if (queue.size()) {
+            dispatchAll(&machine, &queue, false);
+        }
+        else {
+            this_thread::yield();
+        }
+    }
+    producer.join();
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+
+    double ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    cout << name << ": " << (ns / EVENTS) << " ns/event" << endl;
+}
+
+
+// QueueDoubleBufferMutex::push() takes an EventType
+class QueueSwapped : public QueueDoubleBufferMutex<Event, 64> {
+    public:
+        bool push(Event* event) {
+            return QueueDoubleBufferMutex<Event, 64>::push(*event);
+        }
+};
+
+
+int main(int argc, const char* argv[]) {
+    cout << thread::hardware_concurrency() << " cores" << endl;
+    benchmark<QueueLocked>("QueueRingBuffer with a mutex");
+    benchmark<QueueSwapped>("QueueDoubleBufferMutex");
+}
+
+
+#endif
@@ -0,0 +1,98 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <thread>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define MACHINES 1024
+#define EVENTS_PER_MACHINE 2000
+#define WORK 200
+
+
+// Each event does a bit of work and then posts the next event to itself,
+// so all of the machines stay busy without a producer thread becoming the
+// bottleneck.
+class Worker : public FSM {
+    public:
+        Executor* executor;
+        ExecutorMachine* self;
+        uint32_t remaining;
+        volatile uint32_t sum;
+
+        DispatchOutcome stateWORKING(const Event* event) {
+            if (SIG_USER != event->signal) {
+                return TW_HANDLED();
+            }
+            for (uint32_t i = 0; i < WORK; i++) {
+                sum = sum * 31 + i;
+            }
+            if (--remaining) {
+                Event next;
+                next.signal = SIG_USER;
+                executor->post(self, &next);
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+Worker machines[MACHINES];
+QueueRingBuffer<Event, 4> queues[MACHINES];
+
+
+double benchmark(uint32_t workers) {
+    Executor executor(workers);
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        machines[m].executor = &executor;
+        machines[m].self = new ExecutorMachine(&machines[m], &queues[m]);
+        machines[m].remaining = EVENTS_PER_MACHINE;
+        machines[m].sum = 0;
+        machines[m].init((State) &Worker::stateWORKING);
+    }
+    executor.start();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Event event;
+    event.signal = SIG_USER;
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        executor.post(machines[m].self, &event);
+    }
+    executor.waitIdle();
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+
+    executor.stop();
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        delete machines[m].self;
+    }
+    double seconds = chrono::duration_cast<chrono::microseconds>(elapsed).count() / 1e6;
+    return (double(MACHINES) * EVENTS_PER_MACHINE) / seconds;
+}
+
+
+int main(int argc, const char* argv[]) {
+    uint32_t cores = thread::hardware_concurrency();
+    cout << MACHINES << " machines, " << cores << " cores" << endl;
+    double base = 0;
+    for (uint32_t workers = 1; workers <= (cores > 1 ? cores : 2); workers *= 2) {
+        double rate = benchmark(workers);
+        if (1 == workers) {
+            base = rate;
+        }
+        cout << workers << " workers: " << uint32_t(rate) << " events/s"
+            << " (" << (rate / base) << "x)" << endl;
+    }
+}
+
+
+#endif
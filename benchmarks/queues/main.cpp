@@ -0,0 +1,92 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+#define ROUNDS 2000000
+
+
+class Counter : public FSM {
+    public:
+        uint32_t count;
+        DispatchOutcome stateCOUNTING(const Event* event) {
+            count += event->signal;
+            return TW_HANDLED();
+        }
+};
+
+
+// pushes `burst` events then drains them with dispatchAll()
+void benchmark(const char* name, IQueue* queue, uint8_t burst) {
+    Counter machine;
+    machine.count = 0;
+    machine.init((State) &Counter::stateCOUNTING);
+    Event event;
+    event.signal = SIG_USER;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        for (uint8_t i = 0; i < burst; i++) {
+            queue->push_back(&event);
+        }
+        dispatchAll(&machine, queue, false);
+    }
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+
+    double ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    cout << name << " burst " << int(burst) << ": "
+        << (ns / (double(ROUNDS) * burst)) << " ns/event"
+        << " (count " << machine.count << ")" << endl;
+}
+
+
+// the same for QueueLinked, which needs a separate event for each one queued
+void benchmarkLinked(const char* name, QueueLinked* queue, uint8_t burst) {
+    Counter machine;
+    machine.count = 0;
+    machine.init((State) &Counter::stateCOUNTING);
+    LinkedEvent events[256];
+    for (uint16_t i = 0; i < 256; i++) {
+        events[i].signal = SIG_USER;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        for (uint8_t i = 0; i < burst; i++) {
+            queue->push(&events[i]);
+        }
+        dispatchAll(&machine, queue, false);
+    }
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+
+    double ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    cout << name << " burst " << int(burst) << ": "
+        << (ns / (double(ROUNDS) * burst)) << " ns/event"
+        << " (count " << machine.count << ")" << endl;
+}
+
+
+int main(int argc, const char* argv[]) {
+    QueueRingBuffer<Event, 8> small;
+    QueueRingBuffer<Event, 64> large;
+    benchmark("QueueRingBuffer<Event, 8>", &small, 1);
+    benchmark("QueueRingBuffer<Event, 8>", &small, 8);
+    benchmark("QueueRingBuffer<Event, 64>", &large, 32);
+    QueuePacked<256> packed;
+    benchmark("QueuePacked<256>", &packed, 32);
+    QueueLinked linked;
+    benchmarkLinked("QueueLinked", &linked, 8);
+    benchmarkLinked("QueueLinked", &linked, 32);
+}
+
+
+#endif
@@ -0,0 +1,105 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define SESSIONS 200000
+#define BATCH 4096
+#define BATCHES 2000
+#define HOT 2048        // sessions which get most of the events
+
+
+class Session : public FSM {
+    public:
+        uint32_t received;
+        uint8_t padding[40];    // a more realistic machine size
+
+        Session() : received(0) {}
+
+        DispatchOutcome stateOPEN(const Event* event) {
+            received++;
+            return TW_HANDLED();
+        }
+};
+
+
+// a small xorshift, so that both runs see the same ids
+uint32_t nextRandom(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+
+double report(const char* name, chrono::steady_clock::time_point start, uint64_t received) {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double nsPer = seconds * 1e9 / (double(BATCH) * BATCHES);
+    cout << name << ": " << nsPer << " ns per event (" << received << " received)" << endl;
+    return nsPer;
+}
+
+
+int main(int argc, const char* argv[]) {
+    // ids are handed out in a scattered order, like session ids would be
+    Event event;
+    event.signal = SIG_USER;
+    RoutedEvent* batches = new RoutedEvent[BATCH * BATCHES];
+    uint32_t random = 12345;
+    for (uint32_t e = 0; e < BATCH * BATCHES; e++) {
+        uint32_t r = nextRandom(&random);
+        batches[e].id = (r & 3) ? (r >> 8) % HOT * (SESSIONS / HOT) : (r >> 8) % SESSIONS;
+        batches[e].event = &event;
+    }
+
+    // each session allocated separately and found through a hash map
+    unordered_map<uint32_t, Session*> map;
+    for (uint32_t s = 0; s < SESSIONS; s++) {
+        Session* session = new Session();
+        session->init((State) &Session::stateOPEN);
+        map[s] = session;
+    }
+    uint64_t received = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint32_t e = 0; e < BATCH * BATCHES; e++) {
+        unordered_map<uint32_t, Session*>::iterator found = map.find(batches[e].id);
+        if (found != map.end()) {
+            found->second->dispatch(batches[e].event);
+        }
+    }
+    for (uint32_t s = 0; s < SESSIONS; s++) {
+        received += map[s]->received;
+    }
+    double mapped = report("hash map", start, received);
+
+    MachineSlab<Session> slab;
+    for (uint32_t s = 0; s < SESSIONS; s++) {
+        uint32_t id;
+        slab.create(&id)->init((State) &Session::stateOPEN);
+    }
+    received = 0;
+    start = chrono::steady_clock::now();
+    for (uint32_t b = 0; b < BATCHES; b++) {
+        slab.route(batches + b * BATCH, BATCH);
+    }
+    for (uint32_t s = 0; s < SESSIONS; s++) {
+        received += slab.machine(s)->received;
+    }
+    double routed = report("slab route", start, received);
+    cout << "speedup " << mapped / routed << "x" << endl;
+}
+
+
+#endif
@@ -0,0 +1,16 @@
+#!/bin/bash
+#
+# Builds and runs each benchmark (on the host, with optimizations).
+# Pass benchmark names to only run some of them, e.g. ./run.sh queues
+#
+
+cd `dirname $0`
+benchmarks=${@:-`ls -d * | grep -v run.sh`}
+for benchmark in $benchmarks; do
+    echo "=================================================== $benchmark"
+    cd $benchmark
+    g++ -O2 -o main main.cpp || exit 1
+    ./main || exit 2
+    rm -f main
+    cd ..
+done
@@ -0,0 +1,99 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define PER_SHARD 64
+#define EVENTS_PER_MACHINE 2000
+
+
+// Each event is passed on to a machine on the next shard, until every
+// machine has handled its share.
+class Relay : public FSM {
+    public:
+        ShardGroup* group;
+        ShardMachine* next;
+        uint32_t remaining;
+        atomic<uint32_t>* done;
+
+        DispatchOutcome stateRELAYING(const Event* event) {
+            if (SIG_USER != event->signal) {
+                return TW_HANDLED();
+            }
+            if (--remaining) {
+                Event relay;
+                relay.signal = SIG_USER;
+                while (! group->post(next, &relay)) {
+                    this_thread::yield();
+                }
+            }
+            else {
+                (*done)++;
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+int main(int argc, const char* argv[]) {
+    uint32_t cores = thread::hardware_concurrency();
+    uint32_t shards = cores > 1 ? cores : 2;
+    uint32_t machines = shards * PER_SHARD;
+    cout << shards << " shards of " << PER_SHARD << " machines, " << cores << " cores" << endl;
+
+    ShardGroup group(shards, sizeof(Event), 1024, 64);
+    Relay* relays = new Relay[machines];
+    QueueRingBuffer<Event, 4>* queues = new QueueRingBuffer<Event, 4>[machines];
+    ShardMachine** entries = new ShardMachine*[machines];
+    atomic<uint32_t> done(0);
+    for (uint32_t m = 0; m < machines; m++) {
+        entries[m] = group.add(m % shards, &relays[m], &queues[m]);
+    }
+    for (uint32_t m = 0; m < machines; m++) {
+        relays[m].group = &group;
+        relays[m].next = entries[(m + 1) % machines];
+        relays[m].remaining = EVENTS_PER_MACHINE;
+        relays[m].done = &done;
+        relays[m].init((State) &Relay::stateRELAYING);
+    }
+    group.start();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Event event;
+    event.signal = SIG_USER;
+    for (uint32_t m = 0; m < machines; m++) {
+        group.post(entries[m], &event);
+    }
+    while (done.load() < machines) {
+        this_thread::yield();
+    }
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+    group.stop();
+
+    double seconds = chrono::duration_cast<chrono::microseconds>(elapsed).count() / 1e6;
+    cout << uint32_t(double(machines) * EVENTS_PER_MACHINE / seconds) << " events/s" << endl;
+    for (uint32_t s = 0; s < shards; s++) {
+        cout << "shard " << s << ": " << group.dispatched(s) << " dispatched,"
+            << " p50 < " << group.latency(s, 50) << " ns,"
+            << " p99 < " << group.latency(s, 99) << " ns" << endl;
+    }
+    delete[] entries;
+    delete[] queues;
+    delete[] relays;
+}
+
+
+#endif
@@ -0,0 +1,152 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define NAME "/trimwright-benchmark-shmqueue"
+#define EVENTS 1000000
+
+enum Signals {
+    SIG_VALUE = SIG_USER,
+    SIG_DONE,
+};
+
+
+struct ValueEvent : public Event {
+    uint32_t value;
+};
+
+
+class Summer : public FSM {
+    public:
+        uint64_t sum;
+        bool done;
+
+        DispatchOutcome stateSUMMING(const Event* event) {
+            switch (event->signal) {
+                case SIG_VALUE:
+                    sum += ((const ValueEvent*) event)->value;
+                    return TW_HANDLED();
+                case SIG_DONE:
+                    done = true;
+                    return TW_HANDLED();
+            }
+            return TW_UNHANDLED();
+        }
+};
+
+
+void report(const char* name, chrono::steady_clock::time_point start, uint64_t sum) {
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+    double ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    cout << name << ": " << (ns / EVENTS) << " ns/event (sum " << sum << ")" << endl;
+}
+
+
+// the baseline: the producer writes each event to a pipe, and the consumer
+// reads them and copies them into a QueueRingBuffer
+void benchmarkPipe(Summer* summer) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    pid_t child = fork();
+    if (0 == child) {
+        close(fds[0]);
+        ValueEvent event;
+        event.signal = SIG_VALUE;
+        for (uint32_t i = 0; i < EVENTS; i++) {
+            event.value = i;
+            if (write(fds[1], &event, sizeof(event)) != sizeof(event)) {
+                _exit(1);
+            }
+        }
+        event.signal = SIG_DONE;
+        if (write(fds[1], &event, sizeof(event)) != sizeof(event)) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+
+    QueueRingBuffer<ValueEvent, 64> queue;
+    ValueEvent events[64];
+    size_t partial = 0;
+    while (! summer->done) {
+        ssize_t got = read(fds[0], ((uint8_t*) events) + partial, sizeof(events) - partial);
+        if (got <= 0) {
+            break;
+        }
+        partial += got;
+        size_t whole = partial / sizeof(ValueEvent);
+        for (size_t e = 0; e < whole; e++) {
+            queue.push_back(&events[e]);
+        }
+        dispatchAll(summer, &queue, false);
+        partial -= whole * sizeof(ValueEvent);
+        memmove(events, events + whole, partial);
+    }
+    close(fds[0]);
+    waitpid(child, NULL, 0);
+    report("pipe + QueueRingBuffer", start, summer->sum);
+}
+
+
+void benchmarkShared(Summer* summer) {
+    QueueShared queue(NAME, sizeof(ValueEvent), 64, true);
+    if (! queue.ok()) {
+        cout << "couldn't create the shared memory" << endl;
+        return;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    pid_t child = fork();
+    if (0 == child) {
+        QueueShared producer(NAME, sizeof(ValueEvent), 64, false);
+        for (uint32_t i = 0; i <= EVENTS; i++) {
+            ValueEvent* event;
+            while (! (event = (ValueEvent*) producer.reserve())) {
+                sched_yield();
+            }
+            event->signal = (i == EVENTS) ? SIG_DONE : SIG_VALUE;
+            event->value = i;
+            producer.commit(event);
+        }
+        _exit(0);
+    }
+    while (! summer->done) {
+        dispatchAllOrWait(summer, &queue, false, NULL, clockMillis, &queue);
+    }
+    waitpid(child, NULL, 0);
+    report("QueueShared", start, summer->sum);
+}
+
+
+int main(int argc, const char* argv[]) {
+    Summer summer;
+    summer.init((State) &Summer::stateSUMMING);
+
+    summer.sum = 0;
+    summer.done = false;
+    benchmarkPipe(&summer);
+
+    summer.sum = 0;
+    summer.done = false;
+    benchmarkShared(&summer);
+}
+
+
+#endif
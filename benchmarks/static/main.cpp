@@ -0,0 +1,136 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <type_traits>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+#define ROUNDS 2000000
+
+enum {
+    SIG_TICK = SIG_USER,
+    SIG_NEXT,
+};
+
+
+// Four states in a ring, each of which counts SIG_TICK and moves on to the
+// next state on SIG_NEXT.
+#define RING_STATE(name, next) \
+        DispatchOutcome name(const Event* event) { \
+            switch (event->signal) { \
+                case SIG_ENTER: \
+                    entered++; \
+                    return TW_HANDLED(); \
+                case SIG_TICK: \
+                    ticks++; \
+                    return TW_HANDLED(); \
+                case SIG_NEXT: \
+                    return TW_TRANSITION(next); \
+            } \
+            return TW_UNHANDLED(); \
+        }
+
+template <bool STATIC>
+class Flat : public conditional<STATIC, FSMStatic<Flat<STATIC> >, FSM>::type {
+    public:
+        typedef typename conditional<STATIC, FSMStatic<Flat<STATIC> >, FSM>::type Base;
+        using Base::m_stateTemp;
+        uint32_t ticks;
+        uint32_t entered;
+
+        RING_STATE(stateA, &Flat::stateB)
+        RING_STATE(stateB, &Flat::stateC)
+        RING_STATE(stateC, &Flat::stateD)
+        RING_STATE(stateD, &Flat::stateA)
+};
+
+
+// Two leaves three levels down, where SIG_TICK is handled by the top state
+// (so it bubbles up through the others) and SIG_NEXT switches leaves.
+#define HSM_STATE(name, parent, body) \
+        DispatchOutcome name(const Event* event) { \
+            switch (event->signal) { \
+                body \
+            } \
+            return TW_SUPER(parent); \
+        }
+
+template <bool STATIC>
+class Deep : public conditional<STATIC, HSMStatic<Deep<STATIC> >, HSM>::type {
+    public:
+        typedef typename conditional<STATIC, HSMStatic<Deep<STATIC> >, HSM>::type Base;
+        using Base::m_stateTemp;
+        uint32_t ticks;
+        uint32_t entered;
+
+        HSM_STATE(stateTOP, &Deep::stateROOT,
+            case SIG_TICK: ticks++; return TW_HANDLED();
+        )
+        HSM_STATE(stateMIDDLE, &Deep::stateTOP, )
+        HSM_STATE(stateLEFT, &Deep::stateMIDDLE,
+            case SIG_ENTER: entered++; return TW_HANDLED();
+            case SIG_NEXT: return TW_TRANSITION(&Deep::stateRIGHT);
+        )
+        HSM_STATE(stateRIGHT, &Deep::stateMIDDLE,
+            case SIG_ENTER: entered++; return TW_HANDLED();
+            case SIG_NEXT: return TW_TRANSITION(&Deep::stateLEFT);
+        )
+};
+
+
+// dispatches three SIG_TICKs and a SIG_NEXT each round, through a queue
+template <class Machine>
+double benchmark(const char* name, Machine* machine) {
+    machine->ticks = 0;
+    machine->entered = 0;
+    QueueRingBuffer<Event, 4> queue;
+    Event tick, next;
+    tick.signal = SIG_TICK;
+    next.signal = SIG_NEXT;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        queue.push_back(&tick);
+        queue.push_back(&tick);
+        queue.push_back(&tick);
+        queue.push_back(&next);
+        dispatchAll(machine, &queue, false);
+    }
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+
+    double ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count() / (4.0 * ROUNDS);
+    cout << name << ": " << ns << " ns/event"
+        << " (ticks " << machine->ticks << ", entered " << machine->entered << ")" << endl;
+    return ns;
+}
+
+
+int main(int argc, const char* argv[]) {
+    Flat<false> flat;
+    flat.init((State) &Flat<false>::stateA);
+    double virtualFlat = benchmark("FSM", &flat);
+    Flat<true> flatStatic;
+    flatStatic.init(&Flat<true>::stateA);
+    double staticFlat = benchmark("FSMStatic", &flatStatic);
+    cout << "speedup " << virtualFlat / staticFlat << "x" << endl;
+
+    Deep<false> deep;
+    deep.init((State) &Deep<false>::stateLEFT);
+    double virtualDeep = benchmark("HSM", &deep);
+    Deep<true> deepStatic;
+    deepStatic.init(&Deep<true>::stateLEFT);
+    double staticDeep = benchmark("HSMStatic", &deepStatic);
+    cout << "speedup " << virtualDeep / staticDeep << "x" << endl;
+    cout << "size of HSM machine " << sizeof(deep) << ", HSMStatic machine " << sizeof(deepStatic) << endl;
+}
+
+
+#endif
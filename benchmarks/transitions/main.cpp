@@ -0,0 +1,119 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+#define ROUNDS 2000000
+
+enum {
+    SIG_TO_A = SIG_USER,
+    SIG_TO_B,
+};
+
+
+// Two branches, each four states deep, where only the top of each branch
+// has an initial transition and only the leaf has an entry action.
+// Transitions go back and forth between the branches.
+// The composite states in between are declared with TW_SUPER_MASK() when
+// MASKED, so the HSM skips their SIG_ENTER and SIG_INIT.
+#define COMPOSITE(name, parent, mask) \
+        DispatchOutcome name(const Event* event) { \
+            if (SIG_LEAVE == event->signal) { \
+                return TW_LEFT(parent); \
+            } \
+            return MASKED ? TW_SUPER_MASK(parent, mask) : TW_SUPER(parent); \
+        }
+
+template <bool MASKED>
+class Machine : public HSM {
+    public:
+        uint32_t entered;
+
+        DispatchOutcome stateA(const Event* event) {
+            switch (event->signal) {
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateA111);
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateROOT);
+                case SIG_TO_B:
+                    return TW_TRANSITION(&Machine::stateB);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateROOT, TW_ON_INIT) : TW_SUPER(&Machine::stateROOT);
+        }
+        COMPOSITE(stateA1, &Machine::stateA, TW_ON_NONE)
+        COMPOSITE(stateA11, &Machine::stateA1, TW_ON_NONE)
+        DispatchOutcome stateA111(const Event* event) {
+            switch (event->signal) {
+                case SIG_ENTER:
+                    entered++;
+                    return TW_HANDLED();
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateA11);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateA11, TW_ON_ENTER) : TW_SUPER(&Machine::stateA11);
+        }
+
+        DispatchOutcome stateB(const Event* event) {
+            switch (event->signal) {
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateB111);
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateROOT);
+                case SIG_TO_A:
+                    return TW_TRANSITION(&Machine::stateA);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateROOT, TW_ON_INIT) : TW_SUPER(&Machine::stateROOT);
+        }
+        COMPOSITE(stateB1, &Machine::stateB, TW_ON_NONE)
+        COMPOSITE(stateB11, &Machine::stateB1, TW_ON_NONE)
+        DispatchOutcome stateB111(const Event* event) {
+            switch (event->signal) {
+                case SIG_ENTER:
+                    entered++;
+                    return TW_HANDLED();
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateB11);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateB11, TW_ON_ENTER) : TW_SUPER(&Machine::stateB11);
+        }
+};
+
+
+template <bool MASKED>
+void benchmark(const char* name) {
+    Machine<MASKED> machine;
+    machine.entered = 0;
+    machine.init((State) &Machine<MASKED>::stateA);
+    Event toA, toB;
+    toA.signal = SIG_TO_A;
+    toB.signal = SIG_TO_B;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        machine.dispatch(&toB);
+        machine.dispatch(&toA);
+    }
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+
+    double ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    cout << name << ": " << (ns / (2.0 * ROUNDS)) << " ns/transition"
+        << " (entered " << machine.entered << ")" << endl;
+}
+
+
+int main(int argc, const char* argv[]) {
+    benchmark<false>("TW_SUPER");
+    benchmark<true>("TW_SUPER_MASK");
+}
+
+
+#endif
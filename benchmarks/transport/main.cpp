@@ -0,0 +1,102 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+#define EVENTS 2000000
+#define READ_BYTES 1024
+
+
+struct Reading : Event {
+    uint8_t     channel;
+    uint16_t    value;
+};
+
+
+class Counter : public FSM {
+    public:
+        uint32_t count;
+        uint32_t sum;
+        DispatchOutcome stateCOUNTING(const Event* event) {
+            if (SIG_USER == event->signal) {
+                count++;
+                sum += static_cast<const Reading*>(event)->value;
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+// Sends EVENTS frames through a pipe, and decodes what is read in calls
+// of `decodeBytes` bytes (so 1 is parsing a byte at a time).
+void benchmark(const char* name, size_t decodeBytes) {
+    int fds[2];
+    if (pipe(fds)) {
+        return;
+    }
+    QueueRingBuffer<Reading, 200> queue;
+    FrameDecoder<Reading> decoder(&queue);
+    Counter machine;
+    machine.count = 0;
+    machine.sum = 0;
+    machine.init((State) &Counter::stateCOUNTING);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    thread writer([&fds]() {
+        uint8_t frames[4096];
+        uint16_t used = 0;
+        Reading reading;
+        reading.signal = SIG_USER;
+        reading.channel = 0;
+        for (uint32_t e = 0; e < EVENTS; e++) {
+            reading.value = e & 0xFF;
+            used += encodeFrame(frames + used, reading);
+            if (used > sizeof(frames) - 16) {
+                if (write(fds[1], frames, used) != used) {
+                    return;
+                }
+                used = 0;
+            }
+        }
+        if (used && write(fds[1], frames, used) != used) {
+            return;
+        }
+        close(fds[1]);
+    });
+    uint8_t bytes[READ_BYTES];
+    ssize_t got;
+    while ((got = read(fds[0], bytes, sizeof(bytes))) > 0) {
+        for (ssize_t b = 0; b < got; b += decodeBytes) {
+            decoder.decode(bytes + b, (got - b < ssize_t(decodeBytes)) ? got - b : decodeBytes);
+        }
+        dispatchAll(&machine, &queue, false);
+    }
+    writer.join();
+    close(fds[0]);
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::now() - start;
+
+    double ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    double mb = double(EVENTS) * (sizeof(Reading) + TW_FRAME_OVERHEAD) / 1e6;
+    cout << name << ": " << (ns / EVENTS) << " ns/event, " << (mb * 1e9 / ns) << " MB/s";
+    cout << " (" << machine.count << " events, " << decoder.errors() << " errors)" << endl;
+}
+
+
+int main(int argc, const char* argv[]) {
+    benchmark("a byte at a time", 1);
+    benchmark("whole reads", READ_BYTES);
+}
+
+
+#endif
@@ -167,25 +167,23 @@ void Timer::tick() {
     }
 }
 
-void ISR_Button_Change() {
-    TrimWright::Event evt;
-    if (digitalRead(12) == LOW) {
-        evt.signal = SIG_BUTTON_DOWN;
-    } else {
-        evt.signal = SIG_BUTTON_UP;
-    }
-    button.queue.push_back(&evt);
-}
+// The button is sampled every millisecond and debounced, so that contact
+// bounce doesn't reach the state machine as a burst of presses.
+// (Bit 0 of the sample is 1 while the button is down.)
+const TrimWright::InputEdges BUTTON_EDGES[] = {
+    { 0, SIG_BUTTON_DOWN, SIG_BUTTON_UP, &button.queue },
+};
+TrimWright::Debouncer<uint8_t> debouncer(BUTTON_EDGES, 1);
 
 void Button::setup() {
     pinMode(12, INPUT_PULLDOWN);
     bool down = digitalRead(12) == LOW;
+    debouncer = TrimWright::Debouncer<uint8_t>(BUTTON_EDGES, 1, down ? 1 : 0);
     if (down) {
         init((TrimWright::State) &Button::stateDOWN);
     } else {
         init((TrimWright::State) &Button::stateUP);
     }
-    attachInterrupt(12, ISR_Button_Change, CHANGE);
 }
 
 void setup() {
@@ -201,5 +199,6 @@ void loop() {
     delay(1);
     led.tick();
     timer.tick();
+    debouncer.sample(digitalRead(12) == LOW ? 1 : 0);
     button.tick();
 }
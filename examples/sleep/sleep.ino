@@ -0,0 +1,123 @@
+/*
+Copyright 2019 Drew Folta <drew@folta.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include <TrimWright.h>
+
+// Blinks the LED slowly, quickly or not at all, changing each time the
+// button on pin 2 is pressed.  Between the LED's ticks and the presses the
+// CPU sleeps in dispatchAllOrWait() instead of polling in loop().
+
+enum {
+    SIG_TICK = TrimWright::SIG_USER,
+    SIG_PRESS,
+};
+
+// the time events and the button's interrupt both post to this queue
+TrimWright::QueueDoubleBuffer<TrimWright::Event, 4> queue;
+TrimWright::TimeEventList timeEvents;
+
+TrimWright::Ticks clockMillis() {
+    return millis();
+}
+
+// with a clock it sleeps until the next tick is due (or the button is
+// pressed) rather than waking up at every millis() interrupt
+TrimWright::WaiterSleep waiter(clockMillis);
+
+class Blinker : public TrimWright::FSM {
+    private:
+        TrimWright::TimeEvent tick;
+        bool lit;
+    public:
+        Blinker() : tick(SIG_TICK, &queue), lit(false) {}
+        void setup() {
+            timeEvents.add(&tick);
+            init((TrimWright::State) &Blinker::stateSLOW);
+        }
+        void light(bool on) {
+            lit = on;
+            digitalWrite(13, lit ? HIGH : LOW);
+        }
+        void blink(TrimWright::Ticks period) {
+            tick.arm(millis(), period, period);
+        }
+        TrimWright::DispatchOutcome stateSLOW(const TrimWright::Event* evt) {
+            switch (evt->signal) {
+                case TrimWright::SIG_ENTER:
+                    blink(500);
+                    return TW_HANDLED();
+                case SIG_TICK:
+                    light(!lit);
+                    return TW_HANDLED();
+                case SIG_PRESS:
+                    return TW_TRANSITION(&Blinker::stateFAST);
+                default:
+                    return TW_HANDLED();
+            }
+        }
+        TrimWright::DispatchOutcome stateFAST(const TrimWright::Event* evt) {
+            switch (evt->signal) {
+                case TrimWright::SIG_ENTER:
+                    blink(100);
+                    return TW_HANDLED();
+                case SIG_TICK:
+                    light(!lit);
+                    return TW_HANDLED();
+                case SIG_PRESS:
+                    return TW_TRANSITION(&Blinker::stateOFF);
+                default:
+                    return TW_HANDLED();
+            }
+        }
+        TrimWright::DispatchOutcome stateOFF(const TrimWright::Event* evt) {
+            switch (evt->signal) {
+                case TrimWright::SIG_ENTER:
+                    // nothing is armed, so the CPU sleeps until the next press
+                    tick.disarm();
+                    light(false);
+                    return TW_HANDLED();
+                case SIG_PRESS:
+                    return TW_TRANSITION(&Blinker::stateSLOW);
+                default:
+                    return TW_HANDLED();
+            }
+        }
+} blinker;
+
+void ISR_Button() {
+    TrimWright::Event evt;
+    evt.signal = SIG_PRESS;
+    queue.push_back(&evt);
+    // wakes dispatchAllOrWait() for the press
+    waiter.notify();
+}
+
+void setup() {
+    pinMode(13, OUTPUT);
+    pinMode(2, INPUT_PULLDOWN);
+    attachInterrupt(digitalPinToInterrupt(2), ISR_Button, RISING);
+    blinker.setup();
+}
+
+void loop() {
+    TrimWright::dispatchAllOrWait(&blinker, &queue, false, &timeEvents, clockMillis, &waiter);
+}
@@ -0,0 +1,79 @@
+/*
+Copyright 2019 Drew Folta <drew@folta.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// A small part of the Arduino API, for running sketches on a host computer
+// against the simulator in TrimWrightSim.h.  Time only passes when the
+// sketch calls delay() (or when the simulator decides the sketch is idle),
+// and the pins are virtual.
+
+#ifndef TRIMWRIGHT_SIM_ARDUINO_H
+#define TRIMWRIGHT_SIM_ARDUINO_H
+#ifndef ARDUINO
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH            0x1
+#define LOW             0x0
+
+#define INPUT           0x0
+#define OUTPUT          0x1
+#define INPUT_PULLUP    0x2
+#define INPUT_PULLDOWN  0x3
+
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define digitalPinToInterrupt(pin)  (pin)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+void interrupts();
+void noInterrupts();
+
+// (Arduino has these as macros, which would break the C++ standard library)
+template <class A, class B>
+auto min(const A& a, const B& b) -> decltype(a < b ? a : b) {
+    return (a < b) ? a : b;
+}
+template <class A, class B>
+auto max(const A& a, const B& b) -> decltype(a < b ? a : b) {
+    return (a < b) ? b : a;
+}
+
+#endif
+#endif
@@ -0,0 +1,381 @@
+/*
+Copyright 2019 Drew Folta <drew@folta.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ARDUINO
+
+#include "TrimWrightSim.h"
+#include <map>
+#include <vector>
+
+
+//--------------------------------------------------------------------------
+// SIMULATOR STATE
+//
+
+#define TW_SIM_PINS 64
+
+namespace TrimWrightSim {
+
+    struct Pin {
+        uint8_t     mode;
+        int8_t      driven;     // level driven from outside, or -1 if none
+        uint8_t     output;     // level written by the sketch
+        int         analog;
+        uint32_t    writes;
+        void        (*isr)();
+        int         isrMode;
+    };
+
+    struct Change {
+        uint8_t     pin;
+        uint8_t     level;
+    };
+
+    static uint64_t s_now;
+    static uint64_t s_end;
+    static uint32_t s_idleStep = 1000;
+    static bool s_setupDone;
+    static bool s_interruptsEnabled = true;
+    static Pin s_pins[TW_SIM_PINS];
+    static std::multimap<uint64_t, Change> s_changes;  // in time order, then in the order scheduled
+    static std::vector<void (*)()> s_pendingIsrs;       // raised while interrupts were disabled
+    static PinWriteHandler s_onPinWrite;
+
+
+    static Pin*
+    pin(uint8_t number) {
+        return (number < TW_SIM_PINS) ? &s_pins[number] : 0;
+    }
+
+
+    static uint8_t
+    level(const Pin* p) {
+        if (OUTPUT == p->mode) {
+            return p->output;
+        }
+        if (p->driven >= 0) {
+            return uint8_t(p->driven);
+        }
+        return (INPUT_PULLUP == p->mode) ? HIGH : LOW;
+    }
+
+
+    static void
+    raise(void (*isr)()) {
+        if (s_interruptsEnabled) {
+            isr();
+        }
+        else {
+            s_pendingIsrs.push_back(isr);
+        }
+    }
+
+
+    // the time of the next scheduled pin change, or `limit` if that's sooner
+    static uint64_t
+    nextChange(uint64_t limit) {
+        if (s_changes.empty() || s_changes.begin()->first > limit) {
+            return limit;
+        }
+        return s_changes.begin()->first;
+    }
+
+
+    // moves the clock to `until`, applying the pin changes on the way
+    static void
+    advance(uint64_t until) {
+        while (!s_changes.empty() && s_changes.begin()->first <= until) {
+            std::multimap<uint64_t, Change>::iterator first = s_changes.begin();
+            if (first->first > s_now) {
+                s_now = first->first;
+            }
+            Change change = first->second;
+            s_changes.erase(first);
+            setPin(change.pin, change.level);
+        }
+        if (until > s_now) {
+            s_now = until;
+        }
+    }
+
+
+    void
+    reset() {
+        s_now = 0;
+        s_end = 0;
+        s_idleStep = 1000;
+        s_setupDone = false;
+        s_interruptsEnabled = true;
+        for (uint8_t p = 0; p < TW_SIM_PINS; p++) {
+            s_pins[p].mode = INPUT;
+            s_pins[p].driven = -1;
+            s_pins[p].output = LOW;
+            s_pins[p].analog = 0;
+            s_pins[p].writes = 0;
+            s_pins[p].isr = 0;
+            s_pins[p].isrMode = 0;
+        }
+        s_changes.clear();
+        s_pendingIsrs.clear();
+        s_onPinWrite = 0;
+    }
+
+
+    void
+    run(void (*setup)(), void (*loop)(), uint32_t ms) {
+        s_end = s_now + uint64_t(ms) * 1000;
+        if (!s_setupDone) {
+            s_setupDone = true;
+            setup();
+        }
+        while (s_now < s_end) {
+            uint64_t before = s_now;
+            loop();
+            if (s_now == before) {
+                // the sketch is polling, so skip ahead
+                advance(nextChange(s_now + s_idleStep));
+            }
+        }
+    }
+
+
+    void
+    setIdleStep(uint32_t us) {
+        s_idleStep = us ? us : 1;
+    }
+
+
+    uint64_t
+    now() {
+        return s_now;
+    }
+
+
+    void
+    schedulePin(uint32_t atMs, uint8_t number, uint8_t value) {
+        Change change;
+        change.pin = number;
+        change.level = value;
+        s_changes.insert(std::make_pair(uint64_t(atMs) * 1000, change));
+    }
+
+
+    void
+    setPin(uint8_t number, uint8_t value) {
+        Pin* p = pin(number);
+        if (!p) {
+            return;
+        }
+        uint8_t before = level(p);
+        p->driven = value ? HIGH : LOW;
+        uint8_t after = level(p);
+        if (p->isr && before != after) {
+            if (
+                (CHANGE == p->isrMode) ||
+                (RISING == p->isrMode && HIGH == after) ||
+                (FALLING == p->isrMode && LOW == after)
+            ) {
+                raise(p->isr);
+            }
+        }
+    }
+
+
+    void
+    setAnalog(uint8_t number, int value) {
+        Pin* p = pin(number);
+        if (p) {
+            p->analog = value;
+        }
+    }
+
+
+    void
+    interrupt(uint8_t number) {
+        Pin* p = pin(number);
+        if (p && p->isr) {
+            raise(p->isr);
+        }
+    }
+
+
+    void
+    onPinWrite(PinWriteHandler handler) {
+        s_onPinWrite = handler;
+    }
+
+
+    uint32_t
+    pinWrites(uint8_t number) {
+        Pin* p = pin(number);
+        return p ? p->writes : 0;
+    }
+
+
+    uint8_t
+    pinLevel(uint8_t number) {
+        Pin* p = pin(number);
+        return p ? level(p) : LOW;
+    }
+
+
+    void
+    WaiterSim::wait(TrimWright::Ticks timeout) {
+        if (m_notified) {
+            m_notified = false;
+            return;
+        }
+        uint64_t until = s_end;
+        if (TW_TICKS_FOREVER != timeout && s_now + uint64_t(timeout) * 1000 < until) {
+            until = s_now + uint64_t(timeout) * 1000;
+        }
+        advance(nextChange(until));
+        m_notified = false;
+    }
+
+
+    TrimWright::Ticks
+    clockMillis() {
+        return millis();
+    }
+
+
+    // so that the pins start out as inputs, without needing a reset()
+    static struct Startup {
+        Startup() {
+            reset();
+        }
+    } s_startup;
+
+
+};
+using namespace TrimWrightSim;
+
+
+
+//--------------------------------------------------------------------------
+// ARDUINO API
+//
+
+uint32_t
+millis() {
+    return uint32_t(s_now / 1000);
+}
+
+
+uint32_t
+micros() {
+    return uint32_t(s_now);
+}
+
+
+void
+delay(uint32_t ms) {
+    advance(s_now + uint64_t(ms) * 1000);
+}
+
+
+void
+delayMicroseconds(uint32_t us) {
+    advance(s_now + us);
+}
+
+
+void
+pinMode(uint8_t number, uint8_t mode) {
+    Pin* p = pin(number);
+    if (p) {
+        p->mode = mode;
+    }
+}
+
+
+void
+digitalWrite(uint8_t number, uint8_t value) {
+    Pin* p = pin(number);
+    if (!p) {
+        return;
+    }
+    p->output = value ? HIGH : LOW;
+    p->writes++;
+    if (s_onPinWrite) {
+        s_onPinWrite(number, p->output, s_now);
+    }
+}
+
+
+int
+digitalRead(uint8_t number) {
+    Pin* p = pin(number);
+    return p ? level(p) : LOW;
+}
+
+
+int
+analogRead(uint8_t number) {
+    Pin* p = pin(number);
+    return p ? p->analog : 0;
+}
+
+
+void
+analogWrite(uint8_t number, int value) {
+    digitalWrite(number, value ? HIGH : LOW);
+}
+
+
+void
+attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+    Pin* p = pin(interrupt);
+    if (p) {
+        p->isr = isr;
+        p->isrMode = mode;
+    }
+}
+
+
+void
+detachInterrupt(uint8_t interrupt) {
+    Pin* p = pin(interrupt);
+    if (p) {
+        p->isr = 0;
+    }
+}
+
+
+void
+interrupts() {
+    s_interruptsEnabled = true;
+    std::vector<void (*)()> pending;
+    pending.swap(s_pendingIsrs);
+    for (size_t i = 0; i < pending.size(); i++) {
+        pending[i]();
+    }
+}
+
+
+void
+noInterrupts() {
+    s_interruptsEnabled = false;
+}
+
+
+#endif
@@ -0,0 +1,113 @@
+/*
+Copyright 2019 Drew Folta <drew@folta.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// A discrete-event simulator for running Arduino sketches (and TrimWright
+// state machines) on a host computer, faster than real time.
+// The simulated clock jumps straight to the next thing which can happen,
+// such as the end of a delay(), a scheduled change of an input pin, or the
+// next time event when the sketch waits using WaiterSim.
+
+#ifndef TRIMWRIGHT_SIM_H
+#define TRIMWRIGHT_SIM_H
+#ifndef ARDUINO
+
+#include "Arduino.h"
+#include "../../src/TrimWright.h"
+
+namespace TrimWrightSim {
+
+
+    // Forgets all pins, interrupts and scheduled changes, and starts the
+    // clock at zero again.  The next run() calls setup() again.
+    void reset();
+
+    // Calls the sketch's setup() (the first time) and then loop() until
+    // `ms` milliseconds have been simulated.
+    // If a call to loop() doesn't let any time pass then the clock jumps
+    // ahead by the idle step (or to the next scheduled pin change if that's
+    // sooner), so sketches which poll millis() still make progress.
+    void run(void (*setup)(), void (*loop)(), uint32_t ms);
+
+    // how far the clock jumps after a loop() which took no time (default 1ms)
+    void setIdleStep(uint32_t us);
+
+    // the simulated time, in microseconds
+    uint64_t now();
+
+
+    // Drives an input pin from outside (as a button or sensor would),
+    // at `atMs` milliseconds from the start.  The attached interrupt (if
+    // any) is called at that time.
+    void schedulePin(uint32_t atMs, uint8_t pin, uint8_t level);
+
+    // drives an input pin right away
+    void setPin(uint8_t pin, uint8_t level);
+
+    // sets the value analogRead() returns for the pin
+    void setAnalog(uint8_t pin, int value);
+
+    // calls the interrupt attached to the pin, whatever its mode
+    void interrupt(uint8_t pin);
+
+
+    // Called whenever the sketch writes to a pin.
+    typedef void (*PinWriteHandler)(uint8_t pin, uint8_t level, uint64_t us);
+    void onPinWrite(PinWriteHandler handler);
+
+    // the number of digitalWrite() calls to the pin, and the last level
+    uint32_t pinWrites(uint8_t pin);
+    uint8_t pinLevel(uint8_t pin);
+
+
+    // A waiter for dispatchAllOrWait() (using TrimWrightSim::clockMillis)
+    // which jumps the clock to the timeout or to the next scheduled pin
+    // change, whichever is sooner.
+    class WaiterSim : public TrimWright::IWaiter {
+        protected:
+            bool    m_notified;
+        public:
+            WaiterSim() : m_notified(false) {}
+            virtual void wait(TrimWright::Ticks timeout);
+            virtual void notify() {
+                m_notified = true;
+            }
+    };
+
+    // millis() as a TrimWright::Clock
+    TrimWright::Ticks clockMillis();
+
+
+};
+
+
+namespace TrimWright {
+    // Stands in for the WaiterSleep of ARM and AVR Arduinos, so sketches
+    // which sleep run unmodified.  It waits like a WaiterSleep with a
+    // clock, whether or not one is given.
+    class WaiterSleep : public TrimWrightSim::WaiterSim {
+        public:
+            WaiterSleep(Clock = 0) {}
+    };
+};
+
+
+#endif
+#endif
@@ -21,6 +21,13 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "TrimWright.h"
 
+#if defined(ARDUINO) && defined(__AVR__)
+    #include <avr/interrupt.h>
+    #include <avr/sleep.h>
+#elif defined(ARDUINO) && !defined(__arm__)
+    #include <Arduino.h>
+#endif
+
 
 namespace TrimWright {
 
@@ -37,7 +44,6 @@ namespace TrimWright {
         { SIG_INIT },
         { SIG_IDLE }
     };
-    #define _TW_PSEUDO(state,sig) ((this->*(state))(&(PSEUDOEVENTS[sig])))
 
 
     FSM::FSM() : m_stateCurrent(0), m_stateTemp(0) {
@@ -47,23 +53,35 @@ namespace TrimWright {
 
     void
     FSM::TW_METHOD_INIT(State initial) {
-        m_stateCurrent = initial;
-        _TW_PSEUDO(m_stateCurrent, SIG_ENTER);
-        while (DISPATCH_TRANSITION == _TW_PSEUDO(m_stateCurrent, SIG_INIT)) {
-            _TW_PSEUDO(m_stateCurrent, SIG_LEAVE);
-            this->m_stateCurrent = this->m_stateTemp;
-            _TW_PSEUDO(m_stateCurrent, SIG_ENTER);
-        }
-        this->m_stateTemp = 0;
+        FSMEngine<FSM, State>::init(this, initial);
     }
 
 
     void
     FSM::dispatch(const Event* event) {
-        if (DISPATCH_TRANSITION == (this->*m_stateCurrent)(event)) {
-            _TW_PSEUDO(m_stateCurrent, SIG_LEAVE);
-            this->TW_METHOD_INIT(this->m_stateTemp);
+        FSMEngine<FSM, State>::dispatch(this, event);
+    }
+
+
+    uint8_t
+    FSM::stateId(const State* states, uint8_t count) const {
+        for (uint8_t id = 0; id < count; id++) {
+            if (states[id] == m_stateCurrent) {
+                return id;
+            }
         }
+        return TW_STATE_ID_NONE;
+    }
+
+
+    bool
+    FSM::resume(const State* states, uint8_t count, uint8_t id) {
+        if (id >= count || !states[id]) {
+            return false;
+        }
+        m_stateCurrent = states[id];
+        m_stateTemp = 0;
+        return true;
     }
 
 
@@ -74,147 +92,741 @@ namespace TrimWright {
 
     void
     HSM::TW_METHOD_INIT(State initial) {
-        m_stateCurrent = (State) &HSM::stateROOT;
-        m_stateTemp = initial;
-        DispatchOutcome out = DISPATCH_TRANSITION;
-        while (DISPATCH_TRANSITION == out) {
-            State source = m_stateCurrent;  // the transition "from" state
-            State target = m_stateTemp;     // the transition "to" state
-            State path[TRIMWRIGHT_MAX_STATE_DEPTH];
-            int8_t p = 0;
-            for (p = 0; m_stateTemp && (m_stateTemp != source); p++) {
-                path[p] = m_stateTemp;
-                _TW_PSEUDO(m_stateTemp, SIG_SUPER);
+        HSMEngine<HSM, State>::init(this, (State) &HSM::stateROOT, initial);
+    }
+
+
+    void
+    HSM::dispatch(const Event* event) {
+        HSMEngine<HSM, State>::dispatch(this, event);
+    }
+
+
+#if TRIMWRIGHT_HISTORY
+    void
+    HSM::setHistories(History* histories, uint8_t count) {
+        m_histories = histories;
+        m_historyCount = count;
+    }
+#endif
+
+
+#if TRIMWRIGHT_BUBBLE_CACHE
+    void
+    HSM::setBubbleCache(BubbleCache* entries, uint8_t count) {
+        for (uint8_t b = 0; b < count; b++) {
+            entries[b].signal = 0;
+        }
+        m_bubbles = entries;
+        m_bubbleCount = count;
+    }
+#endif
+
+
+    DispatchOutcome
+    HSM::stateROOT(const Event* event) {
+        if (SIG_SUPER == event->signal) {
+            return TW_SUPER(0);
+        }
+        return TW_HANDLED();
+    }
+
+
+
+    //----------------------------------------------------------------------
+    // EVENT QUEUE
+    //
+
+    QueueRingBufferCore::QueueRingBufferCore(void* buffer, uint8_t eventSize, uint8_t capacity) :
+            m_buffer((uint8_t*) buffer),
+            m_end(uint16_t(eventSize) * capacity),
+            m_front(0),
+            m_back(0),
+            m_eventSize(eventSize),
+            m_capacity(capacity),
+            m_size(0),
+            m_reserved(false) {
+        // nothing else to do
+    }
+
+
+    void
+    QueueRingBufferCore::push_back(Event* event) {
+        push_back(event, sizeof(Event));
+    }
+
+
+    bool
+    QueueRingBufferCore::push_back(const Event* event, uint8_t size) {
+        if (m_size >= m_capacity || size > m_eventSize) {
+            // no more room
+            return false;
+        }
+        // the rest of the slot is zeroed rather than read past the event
+        memcpy(m_buffer + m_back, event, size);
+        memset(m_buffer + m_back + size, 0, m_eventSize - size);
+        pushSlot();
+        return true;
+    }
+
+
+    void*
+    QueueRingBufferCore::reserveSlot() {
+        if (m_size >= m_capacity) {
+            // no more room
+            return 0;
+        }
+        m_reserved = true;
+        return m_buffer + m_back;
+    }
+
+
+    void
+    QueueRingBufferCore::commit() {
+        if (!m_reserved) {
+            // nothing was reserved
+            return;
+        }
+        pushSlot();
+    }
+
+
+    void
+    QueueRingBufferCore::pushSlot() {
+        // a push_back() since reserve() has used the reserved slot
+        m_reserved = false;
+        m_back += m_eventSize;
+        if (m_back == m_end) {
+            // wrap around
+            m_back = 0;
+        }
+        m_size++;
+    }
+
+
+    Event*
+    QueueRingBufferCore::front() {
+        if (!m_size) {
+            // nothing on the front
+            return 0;
+        }
+        return (Event*) (m_buffer + m_front);
+    }
+
+
+    void
+    QueueRingBufferCore::pop_front() {
+        if (!m_size) {
+            // nothing to pop
+            return;
+        }
+        m_front += m_eventSize;
+        if (m_front == m_end) {
+            // wrap around
+            m_front = 0;
+        }
+        m_size--;
+    }
+
+
+    uint8_t
+    QueueRingBufferCore::size() {
+        return m_size;
+    }
+
+
+    uint8_t
+    QueueRingBufferCore::saveEvents(void* events) const {
+        uint16_t bytes = uint16_t(m_size) * m_eventSize;
+        uint16_t first = m_end - m_front;
+        if (first > bytes) {
+            first = bytes;
+        }
+        memcpy(events, m_buffer + m_front, first);
+        memcpy(((uint8_t*) events) + first, m_buffer, bytes - first);
+        return m_size;
+    }
+
+
+    void
+    QueueRingBufferCore::restoreEvents(const void* events, uint8_t count) {
+        if (count > m_capacity) {
+            count = m_capacity;
+        }
+        m_front = 0;
+        m_back = uint16_t(count) * m_eventSize;
+        if (m_back == m_end) {
+            // wrap around
+            m_back = 0;
+        }
+        m_size = count;
+        m_reserved = false;
+        memcpy(m_buffer, events, uint16_t(count) * m_eventSize);
+    }
+
+
+
+    // bytes taken by an event of `size` bytes, including its header
+    #define _TW_PACKED_RECORD(size) \
+        ((TRIMWRIGHT_PACKED_ALIGN + uint16_t(size) + TRIMWRIGHT_PACKED_ALIGN - 1) & ~uint16_t(TRIMWRIGHT_PACKED_ALIGN - 1))
+
+
+    QueuePackedCore::QueuePackedCore(void* buffer, uint16_t bytes) :
+            m_buffer((uint8_t*) buffer),
+            m_end(bytes & ~uint16_t(TRIMWRIGHT_PACKED_ALIGN - 1)),
+            m_front(0),
+            m_back(0),
+            m_size(0),
+            m_wrapped(false) {
+        // nothing else to do
+    }
+
+
+    void
+    QueuePackedCore::push_back(Event* event) {
+        push_back(event, sizeof(Event));
+    }
+
+
+    bool
+    QueuePackedCore::push_back(const Event* event, uint8_t size) {
+        if (!size || m_size == 0xFF) {
+            return false;
+        }
+        uint16_t record = _TW_PACKED_RECORD(size);
+        if (m_wrapped) {
+            // the free space is between the back and the front
+            if (record > m_front - m_back) {
+                return false;
+            }
+        }
+        else if (record > m_end - m_back) {
+            // no room at the end, so try the start
+            if (record > m_front) {
+                return false;
             }
-            for (; p > 0; p--) {
-                _TW_PSEUDO(path[p-1], SIG_ENTER);
+            if (m_back < m_end) {
+                // a zero length tells the reader to skip to the start
+                m_buffer[m_back] = 0;
             }
-            m_stateCurrent = target;
-            out = _TW_PSEUDO(m_stateCurrent, SIG_INIT);
+            m_back = 0;
+            m_wrapped = true;
         }
+        m_buffer[m_back] = size;
+        memcpy(m_buffer + m_back + TRIMWRIGHT_PACKED_ALIGN, event, size);
+        m_back += record;
+        m_size++;
+        return true;
+    }
+
+
+    Event*
+    QueuePackedCore::front() {
+        if (!m_size) {
+            // nothing on the front
+            return 0;
+        }
+        return (Event*) (m_buffer + m_front + TRIMWRIGHT_PACKED_ALIGN);
+    }
+
+
+    uint8_t
+    QueuePackedCore::frontSize() const {
+        return m_size ? m_buffer[m_front] : 0;
     }
 
 
     void
-    HSM::dispatch(const Event* event) {
-        State source;           // the state that initiated the transition
-        State target;           // the transition "to" state
-        DispatchOutcome out;
-        State path[TRIMWRIGHT_MAX_STATE_DEPTH];
-        int8_t p, path_end, enter_start;
-
-        // When dispatching the event the DispatchOutcome can be
-        // one of HANDLED, UNHANDLED, TRANSITION, or SUPER.
-        // UNHANDLED is usually returned on a branching handler that
-        // might also return HANDLED. A call to SUPER should be made
-        // to figure out where the event should bubble up to.
-        // (The primary purpose of the UNHANDLED outcome is to facilitate
-        // authoring of sophisticated guard logic within a switch case
-        // without having to repeat the TW_SUPER(). This is so that the
-        // TW_SUPER() is written in one place in the state method, which
-        // is less error-prone should it need to be updated.)
-        m_stateTemp = m_stateCurrent;
-        do {
-            source = m_stateTemp;
-            out = (this->*m_stateTemp)(event);
-            if (out == DISPATCH_UNHANDLED) {
-                out = _TW_PSEUDO(m_stateTemp, SIG_SUPER);
-            }
-        } while (out == DISPATCH_SUPER);
-
-        if (out != DISPATCH_TRANSITION) {
-            // bail early
+    QueuePackedCore::pop_front() {
+        if (!m_size) {
+            // nothing to pop
+            return;
+        }
+        m_size--;
+        if (!m_size) {
+            // start over at the beginning, so there's as much room as possible
+            m_front = m_back = 0;
+            m_wrapped = false;
             return;
         }
+        m_front += _TW_PACKED_RECORD(m_buffer[m_front]);
+        if (m_wrapped && (m_front == m_end || 0 == m_buffer[m_front])) {
+            // wrap around
+            m_front = 0;
+            m_wrapped = false;
+        }
+    }
+
 
-        target = m_stateTemp;
+    uint8_t
+    QueuePackedCore::size() {
+        return m_size;
+    }
 
-        // exit current state to source of transition
-        m_stateTemp = m_stateCurrent;
-        while (m_stateTemp && (m_stateTemp != source)) {
-            if (DISPATCH_HANDLED == _TW_PSEUDO(m_stateTemp, SIG_LEAVE)) {
-                _TW_PSEUDO(m_stateTemp, SIG_SUPER);
+
+
+    QueueFilter::QueueFilter(IQueue* queue, const FSM* machine, const StateSignals* states, uint8_t count) :
+            m_queue(queue),
+            m_machine(machine),
+            m_states(states),
+            m_count(count),
+            m_cachedState(0),
+            m_cachedAccepts(~SignalSet(0)),
+            m_filtered(0) {
+        // nothing else to do
+    }
+
+
+    bool
+    QueueFilter::accepts(uint8_t signal) {
+        if (signal < SIG_USER || signal >= SIG_USER + 32) {
+            return true;
+        }
+        State current = m_machine->currentState();
+        if (current != m_cachedState) {
+            // only look up the state's signals when it changes
+            m_cachedState = current;
+            m_cachedAccepts = ~SignalSet(0);
+            for (uint8_t s = 0; s < m_count; s++) {
+                if (m_states[s].state == current) {
+                    m_cachedAccepts = m_states[s].accepts;
+                    break;
+                }
             }
         }
-        m_stateCurrent = source;
+        return m_cachedAccepts & TW_SIGNAL(signal);
+    }
+
+
+    void
+    QueueFilter::dropIgnored() {
+        while (m_queue->size() && !accepts(m_queue->front()->signal)) {
+            m_queue->pop_front();
+            if (m_filtered != 0xFFFF) {
+                m_filtered++;
+            }
+        }
+    }
+
+
+    void
+    QueueFilter::push_back(Event* event) {
+        push_back(event, sizeof(Event));
+    }
+
+
+    bool
+    QueueFilter::push_back(const Event* event, uint8_t size) {
+        if (!m_queue->size() && !accepts(event->signal)) {
+            if (m_filtered != 0xFFFF) {
+                m_filtered++;
+            }
+            return false;
+        }
+        return m_queue->push_back(event, size);
+    }
+
+
+    Event*
+    QueueFilter::front() {
+        dropIgnored();
+        return m_queue->front();
+    }
+
+
+    void
+    QueueFilter::pop_front() {
+        m_queue->pop_front();
+    }
+
+
+    uint8_t
+    QueueFilter::size() {
+        dropIgnored();
+        return m_queue->size();
+    }
+
+
+
+#if defined(ARDUINO) && defined(__AVR__)
+    CriticalSection::CriticalSection() : m_state(SREG) {
+        cli();
+    }
+
+    CriticalSection::~CriticalSection() {
+        SREG = m_state;
+    }
+#elif defined(ARDUINO) && defined(__arm__)
+    CriticalSection::CriticalSection() {
+        uint32_t primask;
+        __asm__ volatile ("mrs %0, primask" : "=r" (primask));
+        __asm__ volatile ("cpsid i" : : : "memory");
+        m_state = primask;
+    }
+
+    CriticalSection::~CriticalSection() {
+        uint32_t primask = m_state;
+        __asm__ volatile ("msr primask, %0" : : "r" (primask) : "memory");
+    }
+#elif defined(ARDUINO)
+    // The Arduino API can't say whether interrupts were enabled, so these
+    // don't nest on other architectures.
+    CriticalSection::CriticalSection() : m_state(0) {
+        noInterrupts();
+    }
 
-        // transition to self
-        if (source == target) {
-            // All we need to do is leave-and-enter the state.
-            _TW_PSEUDO(source, SIG_LEAVE);
-            _TW_PSEUDO(target, SIG_ENTER);
-            m_stateCurrent = target;
+    CriticalSection::~CriticalSection() {
+        interrupts();
+    }
+#else
+    CriticalSection::CriticalSection() : m_state(0) {}
+    CriticalSection::~CriticalSection() {}
+#endif
+
+
+    QueueLinked::QueueLinked() :
+        m_head(0),
+        m_tail(0),
+        m_count(0),
+        m_rejected(0)
+    {}
+
+
+    bool
+    QueueLinked::push(LinkedEvent* event) {
+        if (event->queued()) {
+            return false;
+        }
+        event->next = 0;
+        if (m_tail) {
+            m_tail->next = event;
         }
         else {
-            // fill path with list of target supers (including target)
-            p = 0;
-            m_stateTemp = target;
-            do {
-                path[p] = m_stateTemp;
-                out = _TW_PSEUDO(m_stateTemp, SIG_SUPER);
-                p++;
-            } while (m_stateTemp && (out == DISPATCH_SUPER));
-            path_end = p;
-
-            // find least common ancestor (LCA)
-            enter_start = -1;
-            do {
-                if (m_stateCurrent == target) {
-                    // target is a super of the state initiated the transition
+            m_head = event;
+        }
+        m_tail = event;
+        m_count++;
+        return true;
+    }
+
+
+    void
+    QueueLinked::push_back(Event*) {
+        m_rejected++;
+    }
+
+
+    bool
+    QueueLinked::push_back(const Event*, uint8_t) {
+        m_rejected++;
+        return false;
+    }
+
+
+    uint16_t
+    QueueLinked::rejected() const {
+        return m_rejected;
+    }
+
+
+    Event*
+    QueueLinked::front() {
+        return m_head;
+    }
+
+
+    void
+    QueueLinked::pop_front() {
+        if (!m_head) {
+            return;
+        }
+        LinkedEvent* popped = m_head;
+        m_head = m_head->next;
+        if (!m_head) {
+            m_tail = 0;
+        }
+        // it can be pushed again
+        popped->next = popped;
+        m_count--;
+    }
+
+
+    uint8_t
+    QueueLinked::size() {
+        return m_count > 0xFF ? 0xFF : m_count;
+    }
+
+
+    bool
+    QueueLinkedISR::push(LinkedEvent* event) {
+        CriticalSection section;
+        return QueueLinked::push(event);
+    }
+
+
+    void
+    QueueLinkedISR::push_back(Event* event) {
+        CriticalSection section;
+        QueueLinked::push_back(event);
+    }
+
+
+    bool
+    QueueLinkedISR::push_back(const Event* event, uint8_t size) {
+        CriticalSection section;
+        return QueueLinked::push_back(event, size);
+    }
+
+
+    Event*
+    QueueLinkedISR::front() {
+        CriticalSection section;
+        return QueueLinked::front();
+    }
+
+
+    void
+    QueueLinkedISR::pop_front() {
+        CriticalSection section;
+        QueueLinked::pop_front();
+    }
+
+
+    uint8_t
+    QueueLinkedISR::size() {
+        CriticalSection section;
+        return QueueLinked::size();
+    }
+
+
+
+    QueueDoubleBufferCore::QueueDoubleBufferCore(void* buffers, uint8_t eventSize, uint8_t capacity) :
+            m_eventSize(eventSize),
+            m_capacity(capacity),
+            m_fill(0),
+            m_filled(0),
+            m_drained(0),
+            m_draining(0) {
+        m_buffers[0] = (uint8_t*) buffers;
+        m_buffers[1] = m_buffers[0] + uint16_t(eventSize) * capacity;
+    }
+
+
+    bool
+    QueueDoubleBufferCore::pushLocked(const void* event, uint8_t size) {
+        CriticalSection section;
+        return pushUnlocked(event, size);
+    }
+
+
+    void
+    QueueDoubleBufferCore::swapLocked() {
+        CriticalSection section;
+        swapUnlocked();
+    }
+
+
+    bool
+    QueueDoubleBufferCore::pushUnlocked(const void* event, uint8_t size) {
+        uint8_t filled = m_filled;
+        if (filled >= m_capacity || size > m_eventSize) {
+            // no more room
+            return false;
+        }
+        uint8_t* slot = m_buffers[m_fill] + uint16_t(m_eventSize) * filled;
+        memcpy(slot, event, size);
+        memset(slot + size, 0, m_eventSize - size);
+        m_filled = filled + 1;
+        return true;
+    }
+
+
+    void
+    QueueDoubleBufferCore::swapUnlocked() {
+        // the consumer's buffer is empty, so it becomes the producers'
+        m_draining = m_filled;
+        m_drained = 0;
+        m_filled = 0;
+        m_fill = m_fill ^ 1;
+    }
+
+
+    void
+    QueueDoubleBufferCore::push_back(Event* event) {
+        pushLocked(event, sizeof(Event));
+    }
+
+
+    bool
+    QueueDoubleBufferCore::push_back(const Event* event, uint8_t size) {
+        return pushLocked(event, size);
+    }
+
+
+    Event*
+    QueueDoubleBufferCore::front() {
+        if (!ready()) {
+            return 0;
+        }
+        return (Event*) (m_buffers[m_fill ^ 1] + uint16_t(m_eventSize) * m_drained);
+    }
+
+
+    void
+    QueueDoubleBufferCore::pop_front() {
+        if (m_drained != m_draining) {
+            m_drained++;
+        }
+    }
+
+
+    uint8_t
+    QueueDoubleBufferCore::size() {
+        ready();
+        return m_draining - m_drained;
+    }
+
+
+
+    //----------------------------------------------------------------------
+    // FRAMED TRANSPORT
+    //
+
+    // the parts of a frame, as FrameDecoderCore::m_state
+    enum {
+        FRAME_SYNC,
+        FRAME_LENGTH,
+        FRAME_EVENT,
+        FRAME_CRC
+    };
+
+    // the CRC of each value of the top nibble, so that the CRC is updated
+    // four bits at a time
+    static const uint8_t FRAME_CRC_NIBBLES[16] = {
+        0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+        0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+    };
+
+
+    uint8_t
+    frameCrc(uint8_t crc, const void* data, uint16_t length) {
+        const uint8_t* bytes = (const uint8_t*) data;
+        while (length--) {
+            crc ^= *bytes++;
+            crc = (crc << 4) ^ FRAME_CRC_NIBBLES[crc >> 4];
+            crc = (crc << 4) ^ FRAME_CRC_NIBBLES[crc >> 4];
+        }
+        return crc;
+    }
+
+
+    uint16_t
+    encodeFrame(uint8_t* frame, const Event* event, uint8_t size) {
+        frame[0] = TW_FRAME_SYNC;
+        frame[1] = size;
+        memcpy(frame + 2, event, size);
+        frame[2 + size] = frameCrc(0, frame + 1, 1 + size);
+        return size + TW_FRAME_OVERHEAD;
+    }
+
+
+    FrameDecoderCore::FrameDecoderCore(IQueue* queue, void* event, uint8_t eventSize) :
+            m_queue(queue),
+            m_event((uint8_t*) event),
+            m_eventSize(eventSize),
+            m_state(FRAME_SYNC),
+            m_length(0),
+            m_have(0),
+            m_crc(0),
+            m_frames(0),
+            m_errors(0) {
+        // nothing else to do
+    }
+
+
+    void
+    FrameDecoderCore::pushEvent(const uint8_t* event, uint8_t length) {
+        m_queue->push_back((const Event*) event, length);
+        m_frames++;
+    }
+
+
+    void
+    FrameDecoderCore::decode(const uint8_t* bytes, size_t count) {
+        const uint8_t* end = bytes + count;
+        while (bytes < end) {
+            switch (m_state) {
+                case FRAME_SYNC: {
+                    const uint8_t* sync = (const uint8_t*) memchr(bytes, TW_FRAME_SYNC, end - bytes);
+                    if (!sync) {
+                        return;
+                    }
+                    bytes = sync + 1;
+                    m_state = FRAME_LENGTH;
                     break;
                 }
-                else {
-                    // see if current state is in the list of supers of the target
-                    for (p = 0; p < path_end; p++) {
-                        if (path[p] == m_stateCurrent) {
-                            enter_start = p - 1;
-                            break;
-                        }
-                    }
-                    if (-1 != enter_start) {
-                        // found it!
+
+                case FRAME_LENGTH: {
+                    uint8_t length = *bytes++;
+                    if (length == 0 || length > m_eventSize) {
+                        m_errors++;
+                        // the length might have been lost, and this is the next frame
+                        m_state = (length == TW_FRAME_SYNC) ? FRAME_LENGTH : FRAME_SYNC;
                         break;
                     }
-                    // leave this state and enter the super state
-                    if (DISPATCH_HANDLED == _TW_PSEUDO(m_stateCurrent, SIG_LEAVE)) {
-                        _TW_PSEUDO(m_stateCurrent, SIG_SUPER);
+                    m_crc = frameCrc(0, &length, 1);
+                    if (size_t(end - bytes) > length) {
+                        // the whole frame is here, so its event is pushed in place
+                        const uint8_t* event = bytes;
+                        bytes += length;
+                        if (frameCrc(m_crc, event, length) == *bytes) {
+                            pushEvent(event, length);
+                            bytes++;
+                        }
+                        else {
+                            // look for the next frame inside this one
+                            m_errors++;
+                            bytes = event - 1;
+                        }
+                        m_state = FRAME_SYNC;
+                        break;
                     }
-                    m_stateCurrent = m_stateTemp;
+                    m_length = length;
+                    m_have = 0;
+                    m_state = FRAME_EVENT;
+                    break;
                 }
-            } while (m_stateCurrent);
 
-            // drill down into the target
-            if (-1 != enter_start) {
-                for (p = enter_start; p >= 0; p--) {
-                    _TW_PSEUDO(path[p], SIG_ENTER);
-                    m_stateCurrent = path[p];
+                case FRAME_EVENT: {
+                    uint8_t need = m_length - m_have;
+                    uint8_t take = (size_t(end - bytes) < need) ? uint8_t(end - bytes) : need;
+                    memcpy(m_event + m_have, bytes, take);
+                    m_crc = frameCrc(m_crc, bytes, take);
+                    m_have += take;
+                    bytes += take;
+                    if (m_have == m_length) {
+                        m_state = FRAME_CRC;
+                    }
+                    break;
                 }
-            }
-        } // not a self-transition
 
-        // Handle the initial transition(s) of the target state
-        while (DISPATCH_TRANSITION == _TW_PSEUDO(m_stateCurrent, SIG_INIT)) {
-            source = m_stateCurrent;    // the transition "from" state
-            target = m_stateTemp;       // the transition "to" state
-            p = 0;
-            for (p = 0; m_stateTemp && (m_stateTemp != source); p++) {
-                path[p] = m_stateTemp;
-                _TW_PSEUDO(m_stateTemp, SIG_SUPER);
-            }
-            for (; p > 0; p--) {
-                _TW_PSEUDO(path[p-1], SIG_ENTER);
+                case FRAME_CRC:
+                    if (*bytes++ == m_crc) {
+                        pushEvent(m_event, m_length);
+                    }
+                    else {
+                        m_errors++;
+                    }
+                    m_state = FRAME_SYNC;
+                    break;
             }
-            m_stateCurrent = target;
         }
     }
 
 
-    DispatchOutcome
-    HSM::stateROOT(const Event* event) {
-        if (SIG_SUPER == event->signal) {
-            return TW_SUPER(0);
-        }
-        return TW_HANDLED();
+    void
+    FrameDecoderCore::reset() {
+        m_state = FRAME_SYNC;
     }
 
 
@@ -246,6 +858,440 @@ namespace TrimWright {
 
 
 
+    //----------------------------------------------------------------------
+    // SNAPSHOTS
+    //
+
+    uint8_t
+    snapshotChecksum(const void* data, uint16_t length) {
+        const uint8_t* bytes = (const uint8_t*) data;
+        uint8_t check = 0x5A;   // so that all-zero memory doesn't pass
+        while (length--) {
+            check = ((check << 1) | (check >> 7)) ^ *bytes++;
+        }
+        return check;
+    }
+
+
+
+    //----------------------------------------------------------------------
+    // TIME EVENTS AND IDLING
+    //
+
+    TimeEvent::TimeEvent(uint8_t sig, IQueue* queue) :
+            m_queue(queue),
+            m_next(0),
+            m_deadline(0),
+            m_interval(0),
+            m_armed(false) {
+        signal = sig;
+    }
+
+
+    void
+    TimeEvent::arm(Ticks now, Ticks delay, Ticks interval) {
+        m_deadline = now + delay;
+        m_interval = interval;
+        m_armed = true;
+    }
+
+
+    void
+    TimeEvent::disarm() {
+        m_armed = false;
+    }
+
+
+    TimeEventList::TimeEventList() : m_first(0) {
+        // nothing else to do
+    }
+
+
+    void
+    TimeEventList::add(TimeEvent* timeEvent) {
+        timeEvent->m_next = m_first;
+        m_first = timeEvent;
+    }
+
+
+    Ticks
+    TimeEventList::post(Ticks now) {
+        Ticks next = TW_TICKS_FOREVER;
+        for (TimeEvent* te = m_first; te; te = te->m_next) {
+            if (!te->m_armed) {
+                continue;
+            }
+            // (signed difference so that this works when the clock wraps)
+            int32_t remaining = int32_t(te->m_deadline - now);
+            if (remaining <= 0) {
+                te->m_queue->push_back(te);
+                if (te->m_interval) {
+                    te->m_deadline += te->m_interval;
+                    remaining = int32_t(te->m_deadline - now);
+                    if (remaining < 0) {
+                        // fell behind, so don't try to catch up
+                        te->m_deadline = now + te->m_interval;
+                        remaining = te->m_interval;
+                    }
+                }
+                else {
+                    te->m_armed = false;
+                    continue;
+                }
+            }
+            if (Ticks(remaining) < next) {
+                next = remaining;
+            }
+        }
+        return next;
+    }
+
+
+#if defined(ARDUINO) && defined(__arm__)
+    bool
+    WaiterSleep::sleepOnce() {
+        // With interrupts masked an interrupt still wakes the CPU from WFI,
+        // which closes the gap between checking m_notified and sleeping.
+        // The waking interrupt only runs once PRIMASK is restored, after
+        // m_notified is cleared, so a notify() from it is seen by the next
+        // call (which returns right away) rather than lost.
+        uint32_t primask;
+        __asm__ volatile ("mrs %0, primask" : "=r" (primask));
+        __asm__ volatile ("cpsid i" : : : "memory");
+        bool notified = m_notified;
+        if (!notified) {
+            __asm__ volatile ("wfi");
+        }
+        m_notified = false;
+        __asm__ volatile ("msr primask, %0" : : "r" (primask) : "memory");
+        return notified;
+    }
+#elif defined(ARDUINO) && defined(__AVR__)
+    bool
+    WaiterSleep::sleepOnce() {
+        // The instruction after SEI is always executed before any interrupt,
+        // which closes the gap between checking m_notified and sleeping.
+        // Unlike on ARM, the waking interrupt runs as soon as the CPU wakes,
+        // so m_notified is read again afterwards to see its notify().
+        cli();
+        bool notified = m_notified;
+        if (!notified) {
+            set_sleep_mode(SLEEP_MODE_IDLE);
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+            cli();
+            notified = m_notified;
+        }
+        m_notified = false;
+        sei();
+        return notified;
+    }
+#endif
+
+
+#if defined(ARDUINO) && (defined(__arm__) || defined(__AVR__))
+    void
+    WaiterSleep::wait(Ticks timeout) {
+        if (!m_clock) {
+            sleepOnce();
+            return;
+        }
+        Ticks start = m_clock();
+        while (!sleepOnce()) {
+            // an interrupt which posted an event without calling notify()
+            // isn't seen until the timeout
+            if (TW_TICKS_FOREVER != timeout && Ticks(m_clock() - start) >= timeout) {
+                return;
+            }
+        }
+    }
+#endif
+
+
+    void
+    dispatchAllOrWait(
+            FSM* machine,
+            IQueue* queue,
+            bool idleIfEmpty,
+            TimeEventList* timeEvents,
+            Clock clock,
+            IWaiter* waiter
+    ) {
+        Ticks timeout = TW_TICKS_FOREVER;
+        if (timeEvents) {
+            timeout = timeEvents->post(clock());
+        }
+        if (queue->size()) {
+            dispatchAll(machine, queue, false);
+            return;
+        }
+        if (idleIfEmpty) {
+            dispatchIdle(machine);
+            if (timeEvents) {
+                // the idle handler might have armed a time event
+                timeout = timeEvents->post(clock());
+            }
+            if (queue->size()) {
+                // the idle handler posted something
+                return;
+            }
+        }
+        if (timeout) {
+            waiter->wait(timeout);
+        }
+    }
+
+
+
+
+    //----------------------------------------------------------------------
+    // LATENCY
+    //
+
+    LatencyMonitor::LatencyMonitor(
+            Clock clock,
+            LatencyHistogram* waits,
+            LatencyHistogram* steps,
+            uint8_t firstSignal,
+            uint8_t signals
+    ) :
+            m_clock(clock),
+            m_waits(waits),
+            m_steps(steps),
+            m_firstSignal(firstSignal),
+            m_signals(signals),
+            m_budget(TW_TICKS_FOREVER),
+            m_overrunHandler(0),
+            m_overruns(0) {
+        // nothing else to do
+    }
+
+
+    void
+    LatencyMonitor::setBudget(Ticks budget, OverrunHandler handler) {
+        m_budget = budget;
+        m_overrunHandler = handler;
+    }
+
+
+    LatencyHistogram*
+    LatencyMonitor::waits(uint8_t signal) {
+        uint8_t index = signal - m_firstSignal;
+        return (m_waits && index < m_signals) ? m_waits + index : 0;
+    }
+
+
+    LatencyHistogram*
+    LatencyMonitor::steps(uint8_t signal) {
+        uint8_t index = signal - m_firstSignal;
+        return (m_steps && index < m_signals) ? m_steps + index : 0;
+    }
+
+
+    void
+    LatencyMonitor::record(const FSM* machine, const Event* event, Ticks wait, Ticks step) {
+        LatencyHistogram* histogram = waits(event->signal);
+        if (histogram) {
+            histogram->record(wait);
+        }
+        histogram = steps(event->signal);
+        if (histogram) {
+            histogram->record(step);
+        }
+        if (step > m_budget) {
+            if (m_overruns != 0xFFFF) {
+                m_overruns++;
+            }
+            if (m_overrunHandler) {
+                m_overrunHandler(machine, event, step);
+            }
+        }
+    }
+
+
+    QueueTimestampedCore::QueueTimestampedCore(IQueue* queue, Clock clock, Ticks* stamps, uint8_t capacity) :
+            m_queue(queue),
+            m_clock(clock),
+            m_stamps(stamps),
+            m_capacity(capacity),
+            m_front(0) {
+        // nothing else to do
+    }
+
+
+    void
+    QueueTimestampedCore::push_back(Event* event) {
+        push_back(event, sizeof(Event));
+    }
+
+
+    bool
+    QueueTimestampedCore::push_back(const Event* event, uint8_t size) {
+        uint8_t count = m_queue->size();
+        if (!m_queue->push_back(event, size)) {
+            return false;
+        }
+        if (count < m_capacity) {
+            uint16_t back = uint16_t(m_front) + count;
+            m_stamps[back < m_capacity ? back : back - m_capacity] = m_clock();
+        }
+        return true;
+    }
+
+
+    Event*
+    QueueTimestampedCore::front() {
+        return m_queue->front();
+    }
+
+
+    void
+    QueueTimestampedCore::pop_front() {
+        if (0 == m_queue->size()) {
+            // the stamps would get out of step with the events
+            return;
+        }
+        m_queue->pop_front();
+        if (++m_front == m_capacity) {
+            m_front = 0;
+        }
+    }
+
+
+    uint8_t
+    QueueTimestampedCore::size() {
+        return m_queue->size();
+    }
+
+
+    Ticks
+    QueueTimestampedCore::frontStamp() const {
+        return m_stamps[m_front];
+    }
+
+
+    void
+    dispatchAllMonitored(FSM* machine, QueueTimestampedCore* queue, LatencyMonitor* monitor) {
+        Clock clock = monitor->clock();
+        while (queue->size()) {
+            Event* event = queue->front();
+            Ticks start = clock();
+            machine->dispatch(event);
+            Ticks step = clock() - start;
+            monitor->record(machine, event, start - queue->frontStamp(), step);
+            queue->pop_front();
+        }
+    }
+
+
+
+
+    //----------------------------------------------------------------------
+    // RATE LIMITING
+    //
+
+    QueueRateLimitedCore::QueueRateLimitedCore(
+            IQueue* queue,
+            Clock clock,
+            const RateLimit* limits,
+            RateBucket* buckets,
+            uint8_t firstSignal,
+            uint8_t signals
+    ) :
+            m_queue(queue),
+            m_clock(clock),
+            m_limits(limits),
+            m_buckets(buckets),
+            m_firstSignal(firstSignal),
+            m_signals(signals),
+            m_dropped(0) {
+        for (uint8_t index = 0; index < signals; index++) {
+            m_buckets[index].last = 0;
+            m_buckets[index].tokens = limits[index].burst;
+            m_buckets[index].dropped = 0;
+        }
+    }
+
+
+    bool
+    QueueRateLimitedCore::admit(uint8_t signal) {
+        uint8_t index = signal - m_firstSignal;
+        if (index >= m_signals || !m_limits[index].interval) {
+            return true;
+        }
+        const RateLimit& limit = m_limits[index];
+        RateBucket& bucket = m_buckets[index];
+        Ticks now = m_clock();
+        Ticks elapsed = now - bucket.last;
+        if (elapsed >= limit.interval) {
+            Ticks earned = elapsed / limit.interval;
+            if (earned >= Ticks(limit.burst - bucket.tokens)) {
+                bucket.tokens = limit.burst;
+            }
+            else {
+                // the rest of the interval counts towards the next token
+                bucket.tokens += earned;
+                bucket.last += earned * limit.interval;
+            }
+        }
+        if (!bucket.tokens) {
+            bucket.dropped++;
+            m_dropped++;
+            return false;
+        }
+        if (bucket.tokens == limit.burst) {
+            // no tokens were earned while the bucket was full
+            bucket.last = now;
+        }
+        bucket.tokens--;
+        return true;
+    }
+
+
+    void
+    QueueRateLimitedCore::push_back(Event* event) {
+        push_back(event, sizeof(Event));
+    }
+
+
+    bool
+    QueueRateLimitedCore::push_back(const Event* event, uint8_t size) {
+        if (!admit(event->signal)) {
+            return false;
+        }
+        return m_queue->push_back(event, size);
+    }
+
+
+    Event*
+    QueueRateLimitedCore::front() {
+        return m_queue->front();
+    }
+
+
+    void
+    QueueRateLimitedCore::pop_front() {
+        m_queue->pop_front();
+    }
+
+
+    uint8_t
+    QueueRateLimitedCore::size() {
+        return m_queue->size();
+    }
+
+
+    uint16_t
+    QueueRateLimitedCore::dropped(uint8_t signal) const {
+        uint8_t index = signal - m_firstSignal;
+        return (index < m_signals) ? m_buckets[index].dropped : 0;
+    }
+
+
+
+
 };
 
 
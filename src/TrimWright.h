@@ -30,7 +30,47 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
     #define TRIMWRIGHT_MAX_STATE_DEPTH 6
 #endif
 
+// alignment of the events in a QueuePacked (and the size of each event's
+// length header), 1 on AVR where nothing needs aligning
+#ifndef TRIMWRIGHT_PACKED_ALIGN
+    #ifdef __AVR__
+        #define TRIMWRIGHT_PACKED_ALIGN 1
+    #else
+        #define TRIMWRIGHT_PACKED_ALIGN 4
+    #endif
+#endif
+
+// number of buckets in a LatencyHistogram, the last one counts everything
+// which took 2^(TRIMWRIGHT_LATENCY_BUCKETS-2) ticks or more
+#ifndef TRIMWRIGHT_LATENCY_BUCKETS
+    #define TRIMWRIGHT_LATENCY_BUCKETS 16
+#endif
+
+// whether HSM has setBubbleCache() (see TW_PASS()), which costs some flash
+// and RAM in every HSM, so it is off unless this is defined to 1
+#ifndef TRIMWRIGHT_BUBBLE_CACHE
+    #define TRIMWRIGHT_BUBBLE_CACHE 0
+#endif
+
+// whether HSM has setHistories() (see TW_HISTORY()), which costs some flash
+// and stack in every HSM's dispatch(), so it is off unless this is defined to 1
+#ifndef TRIMWRIGHT_HISTORY
+    #define TRIMWRIGHT_HISTORY 0
+#endif
+
 #include <stdint.h>
+#include <string.h>
+#ifdef __AVR__
+    #include <new.h>
+#else
+    #include <new>
+#endif
+
+// returned by FSM::stateId() if the current state isn't in the list
+#define TW_STATE_ID_NONE 0xFF
+
+// a timeout which never expires, see TimeEventList and IWaiter
+#define TW_TICKS_FOREVER 0xFFFFFFFF
 
 namespace TrimWright {
 
@@ -50,9 +90,23 @@ namespace TrimWright {
 
     struct Event {
         uint8_t signal;
+
+        Event() = default;
+        constexpr Event(uint8_t sig) : signal(sig) {}
     };
 
 
+    // std::forward(), which AVR doesn't have
+    template <class T> struct _twRemoveReference { typedef T type; };
+    template <class T> struct _twRemoveReference<T&> { typedef T type; };
+    template <class T> struct _twRemoveReference<T&&> { typedef T type; };
+
+    template <class T>
+    T&& _twForward(typename _twRemoveReference<T>::type& value) {
+        return static_cast<T&&>(value);
+    }
+
+
     // Returned by a state as the outcome of dispatching an event to the state.
     // It is much better to use the macros below, for example:
     //      return TW_HANDLED();
@@ -60,7 +114,8 @@ namespace TrimWright {
         DISPATCH_HANDLED,
         DISPATCH_UNHANDLED,
         DISPATCH_TRANSITION,
-        DISPATCH_SUPER
+        DISPATCH_SUPER,
+        DISPATCH_PASS       // a DISPATCH_SUPER which can be cached, see TW_PASS()
     };
 
     // Returned by a state to report that it has handled the event.
@@ -74,12 +129,46 @@ namespace TrimWright {
 
     // Returned by a state to transition to another state.
     // States should never return this when handling SIG_ENTER or SIG_LEAVE.
-    #define TW_TRANSITION(s)    ((m_stateTemp = TrimWright::State(s)), TrimWright::DISPATCH_TRANSITION)
+    #define TW_TRANSITION(s)    ((m_stateTemp = decltype(m_stateTemp)(s)), TrimWright::DISPATCH_TRANSITION)
 
     // Returned by a state (in an HSM) to report the parent state.
     // This should definitely be returned for SIG_SUPER, but is also generally
     // returned for any unhandled event.
-    #define TW_SUPER(s)         ((m_stateTemp = TrimWright::State(s)), TrimWright::DISPATCH_SUPER)
+    #define TW_SUPER(s)         ((m_stateTemp = decltype(m_stateTemp)(s)), TrimWright::DISPATCH_SUPER)
+
+    // Returned by a state (in an HSM) when handling SIG_LEAVE, to report
+    // both that it has been left and what its parent state is.
+    // The HSM needs the parent to continue leaving states, so this saves it
+    // from dispatching a separate SIG_SUPER to the state.
+    #define TW_LEFT(s)          TW_SUPER(s)
+
+#if TRIMWRIGHT_HISTORY
+    // Returned by a state (in an HSM) to transition to the history of a
+    // composite state, which is the substate it was in when it was last left
+    // (see TrimWright::History). If it has never been left then this is a
+    // transition to the composite state itself.
+    #define TW_HISTORY(h)       ((m_stateTemp = ((h).last ? (h).last : (h).composite)), TrimWright::DISPATCH_TRANSITION)
+#endif
+
+    // Returned by a state (in an HSM) for SIG_SUPER, instead of TW_SUPER(),
+    // to also declare which of SIG_ENTER and SIG_INIT the state handles.
+    // `mask` is made of TW_ON_ENTER and TW_ON_INIT (or is TW_ON_NONE).
+    // The HSM asks each state it enters for its super-state anyway, and so
+    // skips dispatching the pseudo-events which the state doesn't handle.
+    // (SIG_LEAVE is always dispatched, since the HSM needs the parent
+    // state then anyway, see TW_LEFT().)
+    #define TW_SUPER_MASK(s, mask)  ((m_stateTemp = decltype(m_stateTemp)(s)), (m_pseudoMask = (mask)), TrimWright::DISPATCH_SUPER)
+    #define TW_ON_NONE          (0)
+    #define TW_ON_ENTER         (1 << TrimWright::SIG_ENTER)
+    #define TW_ON_INIT          (1 << TrimWright::SIG_INIT)
+    #define TW_ON_ALL           (0xFF)
+
+    // Returned by a state (in an HSM) instead of TW_SUPER(), to declare that
+    // it never does anything with this signal except pass it to its parent.
+    // If the HSM has a bubble cache (see TRIMWRIGHT_BUBBLE_CACHE) it remembers
+    // where the event ended up, and the next event with the same signal (in
+    // the same innermost state) goes straight there, skipping these states.
+    #define TW_PASS(s)          ((m_stateTemp = decltype(m_stateTemp)(s)), TrimWright::DISPATCH_PASS)
 
 
 
@@ -90,6 +179,10 @@ namespace TrimWright {
 
     class FSM;
     typedef DispatchOutcome (FSM::* State)(const Event* event);
+    template <class Derived> class FSMStatic;
+    template <class Derived> class HSMStatic;
+    template <class Machine, class StateType> struct FSMEngine;
+    template <class Machine, class StateType> struct HSMEngine;
 
 
     class FSM {
@@ -98,6 +191,13 @@ namespace TrimWright {
             State           m_stateCurrent;
             State           m_stateTemp;
             friend void dispatchIdle(FSM*);
+            template <class Derived> friend class FSMStatic;
+            template <class Derived> friend class HSMStatic;
+            template <class Machine, class StateType> friend struct FSMEngine;
+            template <class Machine, class StateType> friend struct HSMEngine;
+
+            // the object which the engines call the states on
+            FSM* _twSelf() { return this; }
 
         public:
             FSM();
@@ -111,6 +211,22 @@ namespace TrimWright {
             // It doesn't generally need to be overriden by child classes.
             virtual void dispatch(const Event* event);
 
+            // Returns the index of the current state in the `states` list.
+            // The index is a stable id which (unlike the State itself) can
+            // be saved and used after a reset or firmware update.
+            // Returns TW_STATE_ID_NONE if the current state isn't listed.
+            uint8_t stateId(const State* states, uint8_t count) const;
+
+            // Makes `states[id]` the current state without dispatching any
+            // pseudo-events (no SIG_ENTER or SIG_INIT).
+            // This is meant for warm restarts, where the entry actions have
+            // already had their effect before the reset.
+            // Returns false (and changes nothing) if the id isn't valid.
+            bool resume(const State* states, uint8_t count, uint8_t id);
+
+            // the current state (the innermost one, in an HSM)
+            State currentState() const { return m_stateCurrent; }
+
             virtual ~FSM() {}
     };
 
@@ -122,14 +238,78 @@ namespace TrimWright {
     // hierarchical.
     //
 
+#if TRIMWRIGHT_HISTORY
+    // Records the last active substate of a composite state (in an HSM),
+    // so that it can be returned to with TW_HISTORY().
+    // With shallow history that's the direct child of the composite state
+    // (which then takes its own initial transition as usual), and with
+    // deep history it's the innermost state, so that no initial transitions
+    // are taken at all.
+    // (This needs TRIMWRIGHT_HISTORY.)
+    struct History {
+        State   composite;  // the composite state
+        State   last;       // its last active substate (0 until it is left)
+        bool    deep;       // whether to remember the innermost state
+    };
+#endif
+
+
+    // Where an event with `signal` was first not passed on (see TW_PASS())
+    // when it was dispatched to the innermost state `leaf`.
+    struct BubbleCache {
+        State   leaf;
+        State   start;
+        uint8_t signal;     // 0 if the entry isn't used
+    };
+
+
     class HSM : public FSM {
         protected:
+#if TRIMWRIGHT_HISTORY
+            History*        m_histories;
+            uint8_t         m_historyCount;
+#endif
+            uint8_t         m_pseudoMask;   // set by TW_SUPER_MASK()
+#if TRIMWRIGHT_BUBBLE_CACHE
+            BubbleCache*    m_bubbles;
+            uint8_t         m_bubbleCount;
+#endif
+            template <class Machine, class StateType> friend struct HSMEngine;
+
             // root of the state hierarchy
             // top-level states of the application should report this as their
             // super states via TW_SUPER((State) &HSM::stateROOT).
             DispatchOutcome stateROOT(const Event* event);
 
         public:
+            // (inline, so a machine which derives from HSM doesn't need
+            // HSM's own vtable)
+            HSM() : m_pseudoMask(TW_ON_ALL) {
+#if TRIMWRIGHT_HISTORY
+                m_histories = 0;
+                m_historyCount = 0;
+#endif
+#if TRIMWRIGHT_BUBBLE_CACHE
+                m_bubbles = 0;
+                m_bubbleCount = 0;
+#endif
+            }
+
+#if TRIMWRIGHT_HISTORY
+            // Sets the composite states which remember their history.
+            // Only these composite states are tracked, so that machines
+            // which don't use history states don't pay for it.
+            void setHistories(History* histories, uint8_t count);
+#endif
+
+#if TRIMWRIGHT_BUBBLE_CACHE
+            // Sets the cache of where events with states which TW_PASS()
+            // them end up.  Each signal has one entry (signal % count), so
+            // the count is usually the number of signals which are passed.
+            // The entries don't need to be initialized.
+            void setBubbleCache(BubbleCache* entries, uint8_t count);
+#endif
+
             // This performs the transition to the first (initial) state.
             // This will following the "init" internal transition (iteratively,
             // if there are any).
@@ -142,6 +322,402 @@ namespace TrimWright {
 
 
 
+    //----------------------------------------------------------------------
+    // State Machine Engines
+    // The transition logic of FSM and HSM, which FSMStatic and HSMStatic
+    // share.  `Machine` is the machine class (whose _twSelf() is the object
+    // to call the states on) and `StateType` is its type of state.
+    //
+
+    #define _TW_ENGINE_CALL(state,event)    ((machine->_twSelf()->*(state))(event))
+    #define _TW_ENGINE_PSEUDO(state,sig)    _TW_ENGINE_CALL(state, &(FSM::PSEUDOEVENTS[sig]))
+
+    template <class Machine, class StateType>
+    struct FSMEngine {
+        static void init(Machine* machine, StateType initial) {
+            machine->m_stateCurrent = initial;
+            _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_ENTER);
+            while (DISPATCH_TRANSITION == _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_INIT)) {
+                _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_LEAVE);
+                machine->m_stateCurrent = machine->m_stateTemp;
+                _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_ENTER);
+            }
+            machine->m_stateTemp = 0;
+        }
+
+        static void dispatch(Machine* machine, const Event* event) {
+            if (DISPATCH_TRANSITION == _TW_ENGINE_CALL(machine->m_stateCurrent, event)) {
+                _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_LEAVE);
+                init(machine, machine->m_stateTemp);
+            }
+        }
+    };
+
+
+    template <class Machine, class StateType>
+    struct HSMEngine {
+        static void init(Machine* machine, StateType root, StateType initial) {
+            StateType path[TRIMWRIGHT_MAX_STATE_DEPTH];
+            uint8_t masks[TRIMWRIGHT_MAX_STATE_DEPTH];
+            machine->m_stateCurrent = root;
+            machine->m_stateTemp = initial;
+            DispatchOutcome out = DISPATCH_TRANSITION;
+            while (DISPATCH_TRANSITION == out) {
+                StateType source = machine->m_stateCurrent;   // the transition "from" state
+                StateType target = machine->m_stateTemp;      // the transition "to" state
+                int8_t p;
+                for (p = 0; machine->m_stateTemp && (machine->m_stateTemp != source); p++) {
+                    path[p] = machine->m_stateTemp;
+                    machine->m_pseudoMask = TW_ON_ALL;
+                    _TW_ENGINE_PSEUDO(machine->m_stateTemp, SIG_SUPER);
+                    masks[p] = machine->m_pseudoMask;
+                }
+                uint8_t mask = p ? masks[0] : TW_ON_ALL;
+                for (; p > 0; p--) {
+                    if (masks[p-1] & TW_ON_ENTER) {
+                        _TW_ENGINE_PSEUDO(path[p-1], SIG_ENTER);
+                    }
+                }
+                machine->m_stateCurrent = target;
+                out = (mask & TW_ON_INIT) ? _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_INIT) : DISPATCH_HANDLED;
+            }
+        }
+
+#if TRIMWRIGHT_HISTORY
+        // Called as each state is left, to update the machine's histories.
+        // `child` is the state left just before this one (0 if none)
+        // and is updated to be `leaving`.
+        static void rememberHistory(Machine* machine, StateType leaving, StateType& child, StateType leaf) {
+            for (uint8_t h = 0; h < machine->m_historyCount; h++) {
+                if (machine->m_histories[h].composite == leaving) {
+                    if (machine->m_histories[h].deep) {
+                        machine->m_histories[h].last = (leaf != leaving) ? leaf : 0;
+                    }
+                    else {
+                        machine->m_histories[h].last = child;
+                    }
+                }
+            }
+            child = leaving;
+        }
+#endif
+
+        static void dispatch(Machine* machine, const Event* event) {
+            StateType source;       // the state that initiated the transition
+            StateType target;       // the transition "to" state
+            DispatchOutcome out;
+            StateType path[TRIMWRIGHT_MAX_STATE_DEPTH];
+            uint8_t masks[TRIMWRIGHT_MAX_STATE_DEPTH];  // from TW_SUPER_MASK(), for each state in path
+            uint8_t mask = TW_ON_ALL;                   // for the state whose SIG_INIT is next
+            int8_t p, path_end, enter_start;
+#if TRIMWRIGHT_HISTORY
+            StateType leaf;         // the current state before the transition
+            StateType child = 0;    // the state left before the one being left
+#endif
+
+            // When dispatching the event the DispatchOutcome can be
+            // one of HANDLED, UNHANDLED, TRANSITION, or SUPER.
+            // UNHANDLED is usually returned on a branching handler that
+            // might also return HANDLED. A call to SUPER should be made
+            // to figure out where the event should bubble up to.
+            // (The primary purpose of the UNHANDLED outcome is to facilitate
+            // authoring of sophisticated guard logic within a switch case
+            // without having to repeat the TW_SUPER(). This is so that the
+            // TW_SUPER() is written in one place in the state method, which
+            // is less error-prone should it need to be updated.)
+            // (TW_PASS() is the same as TW_SUPER() here, except that with a
+            // bubble cache the states which passed the event are remembered
+            // and skipped next time.)
+            machine->m_stateTemp = machine->m_stateCurrent;
+#if TRIMWRIGHT_BUBBLE_CACHE
+            decltype(machine->m_bubbles) bubble = 0;   // the entry to fill in, once we know
+            if (machine->m_bubbleCount) {
+                bubble = &machine->m_bubbles[event->signal % machine->m_bubbleCount];
+                if (bubble->signal == event->signal && bubble->leaf == machine->m_stateCurrent) {
+                    machine->m_stateTemp = bubble->start;
+                    bubble = 0;
+                }
+            }
+#endif
+            do {
+                source = machine->m_stateTemp;
+                out = _TW_ENGINE_CALL(machine->m_stateTemp, event);
+#if TRIMWRIGHT_BUBBLE_CACHE
+                if (bubble && out != DISPATCH_PASS) {
+                    if (source != machine->m_stateCurrent) {
+                        // all the states below this one passed the event
+                        bubble->leaf = machine->m_stateCurrent;
+                        bubble->start = source;
+                        bubble->signal = event->signal;
+                    }
+                    bubble = 0;
+                }
+#endif
+                if (out == DISPATCH_UNHANDLED) {
+                    out = _TW_ENGINE_PSEUDO(machine->m_stateTemp, SIG_SUPER);
+                }
+            } while (out >= DISPATCH_SUPER);
+
+            if (out != DISPATCH_TRANSITION) {
+                // bail early
+                return;
+            }
+
+            target = machine->m_stateTemp;
+
+            // exit current state to source of transition
+#if TRIMWRIGHT_HISTORY
+            leaf = machine->m_stateCurrent;
+#endif
+            machine->m_stateTemp = machine->m_stateCurrent;
+            while (machine->m_stateTemp && (machine->m_stateTemp != source)) {
+#if TRIMWRIGHT_HISTORY
+                if (machine->m_historyCount) {
+                    rememberHistory(machine, machine->m_stateTemp, child, leaf);
+                }
+#endif
+                // (states which return TW_LEFT() have already reported their parent)
+                if (DISPATCH_SUPER > _TW_ENGINE_PSEUDO(machine->m_stateTemp, SIG_LEAVE)) {
+                    _TW_ENGINE_PSEUDO(machine->m_stateTemp, SIG_SUPER);
+                }
+            }
+            machine->m_stateCurrent = source;
+
+            // transition to self
+            if (source == target) {
+                // All we need to do is leave-and-enter the state.
+#if TRIMWRIGHT_HISTORY
+                if (machine->m_historyCount) {
+                    rememberHistory(machine, source, child, leaf);
+                }
+#endif
+                _TW_ENGINE_PSEUDO(source, SIG_LEAVE);
+                _TW_ENGINE_PSEUDO(target, SIG_ENTER);
+                machine->m_stateCurrent = target;
+            }
+            else {
+                // fill path with list of target supers (including target)
+                p = 0;
+                machine->m_stateTemp = target;
+                do {
+                    path[p] = machine->m_stateTemp;
+                    machine->m_pseudoMask = TW_ON_ALL;
+                    out = _TW_ENGINE_PSEUDO(machine->m_stateTemp, SIG_SUPER);
+                    masks[p] = machine->m_pseudoMask;
+                    p++;
+                } while (machine->m_stateTemp && (out >= DISPATCH_SUPER));
+                path_end = p;
+                mask = masks[0];
+
+                // find least common ancestor (LCA)
+                enter_start = -1;
+                do {
+                    if (machine->m_stateCurrent == target) {
+                        // target is a super of the state initiated the transition
+                        break;
+                    }
+                    else {
+                        // see if current state is in the list of supers of the target
+                        for (p = 0; p < path_end; p++) {
+                            if (path[p] == machine->m_stateCurrent) {
+                                enter_start = p - 1;
+                                break;
+                            }
+                        }
+                        if (-1 != enter_start) {
+                            // found it!
+                            break;
+                        }
+                        // leave this state and enter the super state
+#if TRIMWRIGHT_HISTORY
+                        if (machine->m_historyCount) {
+                            rememberHistory(machine, machine->m_stateCurrent, child, leaf);
+                        }
+#endif
+                        // (states which return TW_LEFT() have already reported their parent)
+                        if (DISPATCH_SUPER > _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_LEAVE)) {
+                            _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_SUPER);
+                        }
+                        machine->m_stateCurrent = machine->m_stateTemp;
+                    }
+                } while (machine->m_stateCurrent);
+
+                // drill down into the target
+                if (-1 != enter_start) {
+                    for (p = enter_start; p >= 0; p--) {
+                        if (masks[p] & TW_ON_ENTER) {
+                            _TW_ENGINE_PSEUDO(path[p], SIG_ENTER);
+                        }
+                        machine->m_stateCurrent = path[p];
+                    }
+                }
+            } // not a self-transition
+
+            // Handle the initial transition(s) of the target state
+            while ((mask & TW_ON_INIT) && DISPATCH_TRANSITION == _TW_ENGINE_PSEUDO(machine->m_stateCurrent, SIG_INIT)) {
+                target = machine->m_stateTemp;      // the transition "to" state
+                for (p = 0; machine->m_stateTemp && (machine->m_stateTemp != machine->m_stateCurrent); p++) {
+                    path[p] = machine->m_stateTemp;
+                    machine->m_pseudoMask = TW_ON_ALL;
+                    _TW_ENGINE_PSEUDO(machine->m_stateTemp, SIG_SUPER);
+                    masks[p] = machine->m_pseudoMask;
+                }
+                mask = p ? masks[0] : TW_ON_ALL;
+                for (; p > 0; p--) {
+                    if (masks[p-1] & TW_ON_ENTER) {
+                        _TW_ENGINE_PSEUDO(path[p-1], SIG_ENTER);
+                    }
+                }
+                machine->m_stateCurrent = target;
+            }
+        }
+    };
+
+
+
+    //----------------------------------------------------------------------
+    // Static State Machines
+    // These behave the same as FSM and HSM, but are templated on the class
+    // which derives from them (the "curiously recurring template pattern")
+    // so that there are no virtual methods, and the states are member
+    // functions of the derived class rather than casts to FSM's.
+    // For example:
+    //      class Blinker : public TrimWright::FSMStatic<Blinker> { ... };
+    //      blinker.init(&Blinker::stateOFF);
+    // The states use the same TW_ macros, and the transitions are done by
+    // the same engines as FSM and HSM.
+    //
+
+    template <class Derived>
+    class FSMStatic {
+        public:
+            typedef DispatchOutcome (Derived::* StaticState)(const Event* event);
+
+        protected:
+            StaticState     m_stateCurrent;
+            StaticState     m_stateTemp;
+            template <class Machine, class StateType> friend struct FSMEngine;
+
+            Derived* _twSelf() { return static_cast<Derived*>(this); }
+
+        public:
+            FSMStatic() : m_stateCurrent(0), m_stateTemp(0) {}
+
+            // see FSM::init()
+            void TW_METHOD_INIT(StaticState initial) {
+                FSMEngine<FSMStatic, StaticState>::init(this, initial);
+            }
+
+            // see FSM::dispatch(), this isn't virtual
+            void dispatch(const Event* event) {
+                FSMEngine<FSMStatic, StaticState>::dispatch(this, event);
+            }
+
+            StaticState currentState() const { return m_stateCurrent; }
+    };
+
+
+#if TRIMWRIGHT_HISTORY
+    // The equivalent of History for an HSMStatic.
+    template <class Derived>
+    struct HistoryStatic {
+        typename HSMStatic<Derived>::StaticState    composite;
+        typename HSMStatic<Derived>::StaticState    last;
+        bool                                        deep;
+    };
+#endif
+
+
+    // The equivalent of BubbleCache for an HSMStatic.
+    template <class Derived>
+    struct BubbleCacheStatic {
+        typename HSMStatic<Derived>::StaticState    leaf;
+        typename HSMStatic<Derived>::StaticState    start;
+        uint8_t                                     signal;
+    };
+
+
+    template <class Derived>
+    class HSMStatic {
+        public:
+            typedef DispatchOutcome (Derived::* StaticState)(const Event* event);
+
+        protected:
+            StaticState                 m_stateCurrent;
+            StaticState                 m_stateTemp;
+#if TRIMWRIGHT_HISTORY
+            HistoryStatic<Derived>*     m_histories;
+            uint8_t                     m_historyCount;
+#endif
+            uint8_t                     m_pseudoMask;   // set by TW_SUPER_MASK()
+#if TRIMWRIGHT_BUBBLE_CACHE
+            BubbleCacheStatic<Derived>* m_bubbles;
+            uint8_t                     m_bubbleCount;
+#endif
+            template <class Machine, class StateType> friend struct HSMEngine;
+
+            Derived* _twSelf() { return static_cast<Derived*>(this); }
+
+            // root of the state hierarchy, which top-level states report
+            // as their super state via TW_SUPER(&Derived::stateROOT)
+            DispatchOutcome stateROOT(const Event* event) {
+                if (SIG_SUPER == event->signal) {
+                    return TW_SUPER(0);
+                }
+                return TW_HANDLED();
+            }
+
+        public:
+            HSMStatic() :
+                m_stateCurrent(0),
+                m_stateTemp(0),
+#if TRIMWRIGHT_HISTORY
+                m_histories(0),
+                m_historyCount(0),
+#endif
+                m_pseudoMask(TW_ON_ALL)
+            {
+#if TRIMWRIGHT_BUBBLE_CACHE
+                m_bubbles = 0;
+                m_bubbleCount = 0;
+#endif
+            }
+
+#if TRIMWRIGHT_HISTORY
+            // see HSM::setHistories()
+            void setHistories(HistoryStatic<Derived>* histories, uint8_t count) {
+                m_histories = histories;
+                m_historyCount = count;
+            }
+#endif
+
+#if TRIMWRIGHT_BUBBLE_CACHE
+            // see HSM::setBubbleCache()
+            void setBubbleCache(BubbleCacheStatic<Derived>* entries, uint8_t count) {
+                for (uint8_t b = 0; b < count; b++) {
+                    entries[b].signal = 0;
+                }
+                m_bubbles = entries;
+                m_bubbleCount = count;
+            }
+#endif
+
+            // see HSM::init()
+            void TW_METHOD_INIT(StaticState initial) {
+                HSMEngine<HSMStatic, StaticState>::init(this, &HSMStatic::stateROOT, initial);
+            }
+
+            // see HSM::dispatch(), this isn't virtual
+            void dispatch(const Event* event) {
+                HSMEngine<HSMStatic, StaticState>::dispatch(this, event);
+            }
+
+            // the current state (the innermost one)
+            StaticState currentState() const { return m_stateCurrent; }
+    };
+
+
+
     //----------------------------------------------------------------------
     // Event Queue
     // This is handy if it's difficult or unnatural for your sketch to
@@ -152,8 +728,22 @@ namespace TrimWright {
     class IQueue {
         public:
             // adds the event to the end of the queue
+            // (queues which copy their events only copy the Event part)
             virtual void push_back(Event*) = 0;
 
+            // Adds the first `size` bytes of the event (of whichever type
+            // derived from Event) to the end of the queue, returns false if
+            // it wasn't added.
+            virtual bool push_back(const Event* event, uint8_t size) = 0;
+
+            // copies the whole event (of whichever type derived from Event),
+            // returns false if it wasn't added
+            template <class EventType>
+            bool push(const EventType& event) {
+                static_assert(sizeof(EventType) < 256, "EventType is too large");
+                return push_back(&event, sizeof(EventType));
+            }
+
             // returns the event at the front of the queue
             virtual Event* front() = 0;
 
@@ -167,59 +757,660 @@ namespace TrimWright {
     };
 
 
+    // Copies a core and the storage (events, stamps or buckets) which the
+    // template wrapping it keeps for it, with the copy's core pointed at the
+    // copy's storage by rebind() (the compiler's copy would leave it
+    // pointing at the original's).  The templates' copy constructors and
+    // assignments use this.
+    template <class Core, class Storage>
+    void _twCopyCore(Core& to, Storage& toStorage, const Core& from, const Storage& fromStorage) {
+        if (&to != &from) {
+            to.Core::operator=(from);
+            memcpy(&toStorage, &fromStorage, sizeof(Storage));
+            to.rebind(&toStorage);
+        }
+    }
+
+
+    // The ring buffer logic of QueueRingBuffer.
+    // This doesn't depend on the event type (only on the size of the events
+    // and the capacity) so the code is shared by all of the QueueRingBuffer
+    // template instantiations, instead of each having its own copy.
+    class QueueRingBufferCore : public IQueue {
+        protected:
+            uint8_t*    m_buffer;
+            uint16_t    m_end;      // size of the buffer in bytes
+            uint16_t    m_front;    // byte offset of the front event
+            uint16_t    m_back;     // byte offset one past the back event
+            uint8_t     m_eventSize;
+            uint8_t     m_capacity;
+            uint8_t     m_size;
+            bool        m_reserved; // reserveSlot() returned the back slot
+
+            QueueRingBufferCore(void* buffer, uint8_t eventSize, uint8_t capacity);
+
+            // adds the back slot to the queue
+            void pushSlot();
+
+            // see QueueRingBuffer for documentation of these
+            void* reserveSlot();
+            uint8_t saveEvents(void* events) const;
+            void restoreEvents(const void* events, uint8_t count);
+
+        public:
+            // points the core at a copy's storage (see _twCopyCore())
+            void rebind(void* storage) {
+                m_buffer = (uint8_t*) storage;
+            }
+
+            // copies the Event part of the event into the ring buffer (and
+            // zeros the rest of the slot)
+            virtual void push_back(Event* event);
+
+            // copies `size` bytes of the event and zeros the rest of the
+            // slot, returns false if there wasn't room or `size` is more
+            // than the slot
+            virtual bool push_back(const Event* event, uint8_t size);
+
+            // adds the event written into the slot returned by reserve()
+            // (this does nothing if reserve() wasn't called, or returned 0)
+            void commit();
+
+            // returns the event in place (no copy is made) so it is only
+            // valid until pop_front() is called
+            virtual Event* front();
+
+            virtual void pop_front();
+
+            virtual uint8_t size();
+    };
+
+
     // a queue implementation that stores (copies of) the events in a ring buffer
     template <class EventType, uint8_t MAX_EVENTS>
-    class QueueRingBuffer : public IQueue {
+    class QueueRingBuffer : public QueueRingBufferCore {
         protected:
-            EventType   m_buffer[MAX_EVENTS];
-            uint8_t     m_front;
-            uint8_t     m_back; // points one past the actual end
+            EventType   m_events[MAX_EVENTS];
+
+        public:
+
+            QueueRingBuffer() : QueueRingBufferCore(m_events, sizeof(EventType), MAX_EVENTS) {
+                static_assert(sizeof(EventType) < 256, "EventType is too large");
+            }
+
+            // the copy has its own events (see _twCopyCore())
+            QueueRingBuffer(const QueueRingBuffer& other) : QueueRingBufferCore(other) {
+                _twCopyCore<QueueRingBufferCore>(*this, m_events, other, other.m_events);
+            }
+
+            QueueRingBuffer& operator=(const QueueRingBuffer& other) {
+                _twCopyCore<QueueRingBufferCore>(*this, m_events, other, other.m_events);
+                return *this;
+            }
+
+            using QueueRingBufferCore::push_back;
+
+            // copies the whole event into the ring buffer
+            void push_back(EventType* event) {
+                QueueRingBufferCore::push_back(event, sizeof(EventType));
+            }
+
+            // returns the event in place (no copy is made) so it is only
+            // valid until pop_front() is called
+            virtual EventType* front() {
+                return static_cast<EventType*>(QueueRingBufferCore::front());
+            }
+
+            // Returns the (uninitialized) slot at the back of the queue, so
+            // that the producer can write the event directly into it,
+            // or 0 if the queue is full.
+            // The event isn't in the queue until commit() is called.
+            EventType* reserve() {
+                return static_cast<EventType*>(reserveSlot());
+            }
+
+            // constructs the event directly in the ring buffer, passing the
+            // arguments to its constructor, returns false if there was no room
+            template <typename... Args>
+            bool emplace_back(Args&&... args) {
+                EventType* slot = reserve();
+                if (!slot) {
+                    return false;
+                }
+                new (slot) EventType(_twForward<Args>(args)...);
+                commit();
+                return true;
+            }
+
+            // copies the events (in order, front first) into `events`,
+            // which must have room for MAX_EVENTS, and returns how many
+            uint8_t save(EventType* events) const {
+                return saveEvents(events);
+            }
+
+            // replaces the contents of the queue with `count` events
+            // (as previously returned by save())
+            void restore(const EventType* events, uint8_t count) {
+                restoreEvents(events, count);
+            }
+    };
+
+
+    // The ring buffer logic of QueuePacked.
+    // Each event is stored with a length header, back to back, so events
+    // of different types only take the room they need.  An event is never
+    // split across the end of the buffer, instead the rest of the buffer is
+    // skipped and the event is stored at the start.
+    class QueuePackedCore : public IQueue {
+        protected:
+            uint8_t*    m_buffer;
+            uint16_t    m_end;      // size of the buffer in bytes
+            uint16_t    m_front;    // byte offset of the front event's header
+            uint16_t    m_back;     // byte offset one past the back event
             uint8_t     m_size;
+            bool        m_wrapped;  // whether m_back has wrapped around to before m_front
+
+            QueuePackedCore(void* buffer, uint16_t bytes);
 
         public:
+            // points the core at a copy's storage (see _twCopyCore())
+            void rebind(void* storage) {
+                m_buffer = (uint8_t*) storage;
+            }
+
+            // copies only the Event part of the event, use push() or the
+            // sized push_back() for derived events
+            virtual void push_back(Event* event);
+
+            // copies `size` bytes of the event, returns false if there
+            // wasn't room
+            virtual bool push_back(const Event* event, uint8_t size);
+
+            // returns the event in place (no copy is made) so it is only
+            // valid until pop_front() is called
+            virtual Event* front();
 
-            QueueRingBuffer() : m_front(0), m_back(0), m_size(0) {
+            // the size the front event was pushed with
+            uint8_t frontSize() const;
+
+            virtual void pop_front();
+
+            virtual uint8_t size();
+    };
+
+
+    // a queue implementation that packs events of different sizes into a
+    // ring buffer of `BYTES` bytes
+    template <uint16_t BYTES>
+    class QueuePacked : public QueuePackedCore {
+        protected:
+            alignas(TRIMWRIGHT_PACKED_ALIGN) uint8_t m_bytes[BYTES];
+
+        public:
+            QueuePacked() : QueuePackedCore(m_bytes, BYTES) {
                 // nothing else to do
             }
 
-            // copies the event into the ring buffer
-            virtual void push_back(EventType* event) {
-                if ((m_size + 1) > MAX_EVENTS) {
-                    // no more room
-                    return;
+            // the copy has its own events (see _twCopyCore())
+            QueuePacked(const QueuePacked& other) : QueuePackedCore(other) {
+                _twCopyCore<QueuePackedCore>(*this, m_bytes, other, other.m_bytes);
+            }
+
+            QueuePacked& operator=(const QueuePacked& other) {
+                _twCopyCore<QueuePackedCore>(*this, m_bytes, other, other.m_bytes);
+                return *this;
+            }
+    };
+
+
+    // A set of the user signals SIG_USER to SIG_USER+31, one bit each.
+    // (Signals outside that range can't be filtered.)
+    typedef uint32_t SignalSet;
+    #define TW_SIGNAL(sig)      (TrimWright::SignalSet(1) << ((sig) - TrimWright::SIG_USER))
+
+    // The signals which a state accepts, which should include the ones its
+    // super-states handle (since those events bubble up to them).
+    struct StateSignals {
+        State       state;
+        SignalSet   accepts;
+    };
+
+
+    // Decorates the queue of a machine, dropping events which the machine's
+    // current state doesn't accept, so that they don't take up room in the
+    // queue or get dispatched just to be ignored.
+    // An event is dropped when it's pushed if the queue is empty (since the
+    // state can't change before it is dispatched), or otherwise once it
+    // reaches the front of the queue (since the events ahead of it might
+    // change the state).  So all events for the machine need to go through
+    // this queue.  States which aren't in the list accept all signals.
+    class QueueFilter : public IQueue {
+        protected:
+            IQueue*             m_queue;
+            const FSM*          m_machine;
+            const StateSignals* m_states;
+            uint8_t             m_count;
+            State               m_cachedState;      // the state m_cachedAccepts is for
+            SignalSet           m_cachedAccepts;
+            uint16_t            m_filtered;
+
+            bool accepts(uint8_t signal);
+            void dropIgnored();
+
+        public:
+            QueueFilter(IQueue* queue, const FSM* machine, const StateSignals* states, uint8_t count);
+
+            virtual void push_back(Event* event);
+            virtual bool push_back(const Event* event, uint8_t size);
+            virtual Event* front();
+            virtual void pop_front();
+            virtual uint8_t size();
+
+            // the number of events which were dropped
+            uint16_t filtered() const { return m_filtered; }
+    };
+
+
+
+    // Masks interrupts for as long as it exists, and then restores them to
+    // how they were (so these can be nested).  On a host this does nothing.
+    class CriticalSection {
+        protected:
+            uintptr_t   m_state;
+
+        public:
+            CriticalSection();
+            ~CriticalSection();
+    };
+
+
+    // An Event which can be linked into a QueueLinked.
+    // `next` points back at the event itself while it isn't in a queue, so
+    // that pushing it twice can be caught.  A copy isn't in any queue, and
+    // assigning to an event doesn't change its place in a queue.
+    struct LinkedEvent : Event {
+        LinkedEvent*    next;
+
+        LinkedEvent() : next(this) {}
+        LinkedEvent(uint8_t sig) : Event(sig), next(this) {}
+        LinkedEvent(const LinkedEvent& other) : Event(other), next(this) {}
+        LinkedEvent& operator=(const LinkedEvent& other) {
+            signal = other.signal;
+            return *this;
+        }
+
+        bool queued() const { return next != this; }
+    };
+
+
+    // A queue which links events together instead of copying them, so it
+    // has no capacity of its own.  This suits events which already live
+    // somewhere (static or pooled), since push_back() and pop_front() are
+    // O(1) and the queue only takes up room for the events in it.
+    // Each event needs to be a LinkedEvent, which stays where it is (and
+    // unchanged) until it has been popped, and can only be in one queue.
+    class QueueLinked : public IQueue {
+        protected:
+            LinkedEvent*    m_head;
+            LinkedEvent*    m_tail;
+            uint16_t        m_count;
+            uint16_t        m_rejected;
+
+        public:
+            QueueLinked();
+
+            // links the event in, returns false if it's already in a queue
+            virtual bool push(LinkedEvent* event);
+
+            // An Event* can't be told apart from a LinkedEvent*, so events
+            // pushed through IQueue are rejected (and counted) instead of
+            // linked.  Use push().
+            virtual void push_back(Event* event);
+            virtual bool push_back(const Event* event, uint8_t size);
+            uint16_t rejected() const;
+
+            virtual Event* front();
+            virtual void pop_front();
+
+            // stops at 255, since that's the most IQueue can report
+            virtual uint8_t size();
+    };
+
+
+    // A QueueLinked which can be pushed onto from interrupt handlers.
+    class QueueLinkedISR : public QueueLinked {
+        public:
+            virtual bool push(LinkedEvent* event);
+            virtual void push_back(Event* event);
+            virtual bool push_back(const Event* event, uint8_t size);
+            virtual Event* front();
+            virtual void pop_front();
+            virtual uint8_t size();
+    };
+
+
+
+    // The logic of QueueDoubleBuffer.
+    // Producers copy events into one buffer while the consumer drains the
+    // other, and the two are swapped when the consumer's buffer is empty.
+    class QueueDoubleBufferCore : public IQueue {
+        protected:
+            uint8_t*            m_buffers[2];
+            uint8_t             m_eventSize;
+            uint8_t             m_capacity;         // of each buffer
+            volatile uint8_t    m_fill;             // the producers' buffer
+            volatile uint8_t    m_filled;           // events in the producers' buffer
+            uint8_t             m_drained;          // events popped from the consumer's buffer
+            uint8_t             m_draining;         // events in the consumer's buffer
+
+            QueueDoubleBufferCore(void* buffers, uint8_t eventSize, uint8_t capacity);
+
+            // These are the parts which need to be synchronized between the
+            // producers and the consumer, which are done in a CriticalSection.
+            // A derived class can override them to use a different lock,
+            // around pushUnlocked() and swapUnlocked().
+            virtual bool pushLocked(const void* event, uint8_t size);
+            virtual void swapLocked();
+
+            bool pushUnlocked(const void* event, uint8_t size);
+            void swapUnlocked();
+
+            // swaps the buffers if the consumer's one has been drained
+            bool ready() {
+                if (m_drained == m_draining) {
+                    swapLocked();
                 }
-                m_buffer[m_back] = *event;
-                m_back++;
-                if (m_back == MAX_EVENTS) {
-                    // wrap around
-                    m_back = 0;
+                return m_drained != m_draining;
+            }
+
+        public:
+            // points the core at a copy's storage (see _twCopyCore())
+            void rebind(void* storage) {
+                m_buffers[0] = (uint8_t*) storage;
+                m_buffers[1] = m_buffers[0] + uint16_t(m_eventSize) * m_capacity;
+            }
+
+            // copies the Event part of the event into the producers' buffer
+            // (the event is dropped if it's full)
+            virtual void push_back(Event* event);
+
+            // copies `size` bytes of the event (and zeros the rest of the
+            // slot), returns false if there was no room
+            virtual bool push_back(const Event* event, uint8_t size);
+
+            // returns the event in place, so it is only valid until
+            // pop_front() is called
+            virtual Event* front();
+            virtual void pop_front();
+
+            // the number of events in the consumer's buffer (once they have
+            // been popped, this swaps and returns the next batch)
+            virtual uint8_t size();
+    };
+
+
+    // A queue for events posted by interrupt handlers (or other threads),
+    // which has just one critical section per batch on the consumer side.
+    // Each of the two buffers holds MAX_EVENTS events.
+    template <class EventType, uint8_t MAX_EVENTS>
+    class QueueDoubleBuffer : public QueueDoubleBufferCore {
+        protected:
+            EventType   m_events[2 * MAX_EVENTS];
+
+        public:
+            QueueDoubleBuffer() : QueueDoubleBufferCore(m_events, sizeof(EventType), MAX_EVENTS) {
+                static_assert(sizeof(EventType) < 256, "EventType is too large");
+            }
+
+            // the copy has its own events (see _twCopyCore())
+            QueueDoubleBuffer(const QueueDoubleBuffer& other) : QueueDoubleBufferCore(other) {
+                _twCopyCore<QueueDoubleBufferCore>(*this, m_events, other, other.m_events);
+            }
+
+            QueueDoubleBuffer& operator=(const QueueDoubleBuffer& other) {
+                _twCopyCore<QueueDoubleBufferCore>(*this, m_events, other, other.m_events);
+                return *this;
+            }
+
+            // copies the whole event, returns false if there was no room
+            bool push(const EventType& event) {
+                return pushLocked(&event, sizeof(EventType));
+            }
+    };
+
+
+
+    //----------------------------------------------------------------------
+    // Internal Events
+    // Events a machine posts to itself (such as completion events), which
+    // are dispatched as soon as the current event has been handled, before
+    // any more external events.
+    //
+
+    // Adds an internal queue to a machine, for example
+    //      class Door : public WithInternalQueue<HSM, Event, 4> { ... };
+    // or over a static machine
+    //      class Door : public WithInternalQueue<HSMStatic<Door>, Event, 4> { ... };
+    // A handler calls postSelf() instead of pushing onto the external queue,
+    // and dispatch() dispatches the posted events (and any they post) in a
+    // loop once the handler returns, rather than recursively.
+    template <class Machine, class EventType, uint8_t CAPACITY>
+    class WithInternalQueue : public Machine {
+        protected:
+            QueueRingBuffer<EventType, CAPACITY>    m_internal;
+
+            // Posts an event for this machine to handle once the current
+            // event is done, returns false if the internal queue is full.
+            bool postSelf(const EventType& event) {
+                EventType* slot = m_internal.reserve();
+                if (!slot) {
+                    return false;
                 }
-                m_size++;
+                *slot = event;
+                m_internal.commit();
+                return true;
             }
 
-            virtual EventType* front() {
-                if (!m_size) {
-                    // nothing on the front
-                    return 0;
+            void dispatchInternal() {
+                while (m_internal.size()) {
+                    Machine::dispatch(m_internal.front());
+                    m_internal.pop_front();
                 }
-                return &(m_buffer[m_front]);
             }
 
-            virtual void pop_front() {
-                if (!m_size) {
-                    // nothing to pop
-                    return;
+        public:
+            // events posted by the initial transition are dispatched before this returns
+            // (StateType is State, or the static machine's StaticState)
+            template <class StateType>
+            void TW_METHOD_INIT(StateType initial) {
+                Machine::TW_METHOD_INIT(initial);
+                dispatchInternal();
+            }
+
+            // (this is virtual over FSM and HSM through their dispatch(),
+            // but not over a static machine, which has no vtable)
+            void dispatch(const Event* event) {
+                Machine::dispatch(event);
+                dispatchInternal();
+            }
+    };
+
+
+
+    //----------------------------------------------------------------------
+    // Input Debouncing
+    // Turns raw digital inputs (such as buttons) into clean edge events.
+    //
+
+    // Which events to post when a debounced input changes.
+    // A signal of 0 means that edge isn't posted.
+    struct InputEdges {
+        uint8_t     input;      // bit number in the sampled word
+        uint8_t     rising;     // signal posted when the input goes to 1
+        uint8_t     falling;    // signal posted when the input goes to 0
+        IQueue*     queue;
+    };
+
+
+    // Debounces all the bits of `Word` (uint8_t up to uint64_t) at once,
+    // with a two-bit "vertical" counter per input spread over two words.
+    // An input only changes once it has been sampled with its new value
+    // four times in a row, and the work per sample is the same no matter
+    // how many inputs there are.  sample() would usually be called from a
+    // timer every few milliseconds, with all the inputs read as one word.
+    template <class Word>
+    class Debouncer {
+        protected:
+            Word                m_state;    // the debounced inputs
+            Word                m_count0;   // low bit of each input's counter
+            Word                m_count1;   // high bit of each input's counter
+            const InputEdges*   m_edges;
+            uint8_t             m_edgeCount;
+
+        public:
+            // `initial` is the state the inputs start in (no edges are
+            // posted for it).
+            Debouncer(const InputEdges* edges, uint8_t count, Word initial = 0) :
+                m_state(initial),
+                m_count0(0),
+                m_count1(0),
+                m_edges(edges),
+                m_edgeCount(count)
+            {}
+
+            // Adds a sample of the raw inputs, and posts the events for
+            // the inputs which changed.  Returns the bits which changed.
+            Word sample(Word raw) {
+                Word delta = raw ^ m_state;
+                // count up the inputs which differ, and reset the others
+                m_count1 = (m_count1 ^ m_count0) & delta;
+                m_count0 = ~m_count0 & delta;
+                // the counters which wrapped around are the ones which change
+                Word changed = delta & ~(m_count0 | m_count1);
+                if (!changed) {
+                    return 0;
                 }
-                m_front++;
-                if (m_front == MAX_EVENTS) {
-                    // wrap around
-                    m_front = 0;
+                m_state ^= changed;
+                for (uint8_t e = 0; e < m_edgeCount; e++) {
+                    const InputEdges& edges = m_edges[e];
+                    Word bit = Word(1) << edges.input;
+                    if (!(changed & bit)) {
+                        continue;
+                    }
+                    Event event;
+                    event.signal = (m_state & bit) ? edges.rising : edges.falling;
+                    if (event.signal) {
+                        edges.queue->push_back(&event);
+                    }
                 }
-                m_size--;
+                return changed;
             }
 
-            virtual uint8_t size() {
-                return m_size;
+            // the debounced inputs
+            Word state() const { return m_state; }
+    };
+
+
+
+    //----------------------------------------------------------------------
+    // Framed Transport
+    // Carries events over a byte stream (such as a serial port or a pipe).
+    // Each event is sent as a frame of
+    //      TW_FRAME_SYNC, length, signal, payload..., crc
+    // where the signal and payload are the bytes of the event (so the event
+    // struct needs the same layout on both ends), `length` is how many
+    // bytes that is, and `crc` is the CRC-8 of the length and the event.
+    //
+
+    #define TW_FRAME_SYNC       (0x7E)
+    #define TW_FRAME_OVERHEAD   (3)     // bytes a frame adds to its event
+
+    // Continues the CRC-8 (polynomial 0x07) `crc` over `length` bytes.
+    // A frame's CRC starts at 0.
+    uint8_t frameCrc(uint8_t crc, const void* data, uint16_t length);
+
+
+    // Writes the frame for `size` bytes of the event into `frame`, which
+    // needs room for `size + TW_FRAME_OVERHEAD` bytes, and returns the
+    // number of bytes written.
+    uint16_t encodeFrame(uint8_t* frame, const Event* event, uint8_t size);
+
+    // the same for the whole event (of whichever type derived from Event)
+    template <class EventType>
+    uint16_t encodeFrame(uint8_t* frame, const EventType& event) {
+        static_assert(sizeof(EventType) < 256, "EventType is too large");
+        return encodeFrame(frame, &event, sizeof(EventType));
+    }
+
+
+    // The logic of FrameDecoder.
+    // A frame which is all in the bytes given to decode() is pushed from
+    // where it is, and a frame which is split across calls is put back
+    // together in the event buffer, so each event is only copied by the
+    // queue.  (The queue has to copy the events, so can't be a QueueLinked.)
+    // Frames with a bad length or CRC are dropped, and decoding continues
+    // with the next TW_FRAME_SYNC (from inside the dropped frame, if it was
+    // all in one call).
+    class FrameDecoderCore {
+        protected:
+            IQueue*     m_queue;
+            uint8_t*    m_event;        // where a split frame's event is put together
+            uint8_t     m_eventSize;
+            uint8_t     m_state;        // the part of the frame expected next
+            uint8_t     m_length;       // of the current frame's event
+            uint8_t     m_have;         // bytes of the event received so far
+            uint8_t     m_crc;          // of the current frame so far
+            uint16_t    m_frames;
+            uint16_t    m_errors;
+
+            FrameDecoderCore(IQueue* queue, void* event, uint8_t eventSize);
+
+            void pushEvent(const uint8_t* event, uint8_t length);
+
+        public:
+            // points the core at a copy's storage (see _twCopyCore())
+            void rebind(void* storage) {
+                m_event = (uint8_t*) storage;
+            }
+
+            // Decodes `count` bytes (as many as were read, which needn't end
+            // at the end of a frame) and pushes their events to the queue.
+            void decode(const uint8_t* bytes, size_t count);
+
+            // forgets the frame which has been partly decoded, if any
+            void reset();
+
+            // the number of frames which were decoded and pushed
+            uint16_t frames() const { return m_frames; }
+
+            // the number of frames which were dropped
+            uint16_t errors() const { return m_errors; }
+    };
+
+
+    // Decodes frames into events of up to the size of `EventType`, which
+    // should be the event type of the queue (or the largest event in a
+    // QueuePacked).  Events are pushed with their own size, so a queue of
+    // fixed size slots zeros the rest, and frames of longer events are
+    // dropped.
+    template <class EventType>
+    class FrameDecoder : public FrameDecoderCore {
+        protected:
+            EventType   m_buffer;
+
+        public:
+            FrameDecoder(IQueue* queue) : FrameDecoderCore(queue, &m_buffer, sizeof(EventType)) {
+                static_assert(sizeof(EventType) < 256, "EventType is too large");
+            }
+
+            // the copy has its own buffer (see _twCopyCore())
+            FrameDecoder(const FrameDecoder& other) : FrameDecoderCore(other) {
+                _twCopyCore<FrameDecoderCore>(*this, m_buffer, other, other.m_buffer);
+            }
+
+            FrameDecoder& operator=(const FrameDecoder& other) {
+                _twCopyCore<FrameDecoderCore>(*this, m_buffer, other, other.m_buffer);
+                return *this;
             }
     };
 
@@ -239,6 +1430,491 @@ namespace TrimWright {
     // then a SIG_IDLE event will be dispatched to the state machine.
     void dispatchAll(FSM* machine, IQueue* queue, bool idleIfEmpty);
 
+
+    // The same for FSMStatic and HSMStatic machines.
+    // `machine` is the most-derived class, so that a dispatch() it overrides
+    // (such as WithInternalQueue's) is the one called.
+    template <class Machine>
+    void dispatchStaticAll(Machine* machine, IQueue* queue, bool idleIfEmpty) {
+        if (queue->size()) {
+            while (queue->size()) {
+                machine->dispatch(queue->front());
+                queue->pop_front();
+            }
+        }
+        else if (idleIfEmpty) {
+            static const Event IDLE = { SIG_IDLE };
+            machine->dispatch(&IDLE);
+        }
+    }
+
+    template <class Derived>
+    void dispatchAll(FSMStatic<Derived>* machine, IQueue* queue, bool idleIfEmpty) {
+        dispatchStaticAll(static_cast<Derived*>(machine), queue, idleIfEmpty);
+    }
+
+    template <class Derived>
+    void dispatchAll(HSMStatic<Derived>* machine, IQueue* queue, bool idleIfEmpty) {
+        dispatchStaticAll(static_cast<Derived*>(machine), queue, idleIfEmpty);
+    }
+
+
+
+    //----------------------------------------------------------------------
+    // Snapshots
+    // These capture the current state of a machine (as a stable state id)
+    // and the pending events of its queue into a small fixed-size blob.
+    // Restoring a snapshot resumes the machine directly, without replaying
+    // any SIG_ENTER or SIG_INIT pseudo-events, which makes warm restarts
+    // (after a watchdog reset or firmware update) very quick.
+    // An HSM's History records aren't saved, the sketch owns those.
+    //
+
+    template <class EventType, uint8_t MAX_EVENTS>
+    struct Snapshot {
+        uint8_t     check;      // checksum of the rest of the snapshot
+        uint8_t     version;    // application-defined, see restoreSnapshot()
+        uint8_t     state;      // see FSM::stateId()
+        uint8_t     size;       // number of events which are valid
+        EventType   events[MAX_EVENTS];
+    };
+
+
+    // Returns the checksum of `length` bytes.
+    uint8_t snapshotChecksum(const void* data, uint16_t length);
+
+
+    // Fills `snapshot` with the state of the machine and the events in the
+    // queue. The queue can be 0 if only the machine state is wanted.
+    // The `states` list is used to compute the state id, and so it
+    // needs to be the same list when the snapshot is restored.
+    template <class EventType, uint8_t MAX_EVENTS>
+    void saveSnapshot(
+            Snapshot<EventType, MAX_EVENTS>* snapshot,
+            uint8_t version,
+            const FSM* machine,
+            const State* states,
+            uint8_t count,
+            const QueueRingBuffer<EventType, MAX_EVENTS>* queue
+    ) {
+        snapshot->version = version;
+        snapshot->state = machine->stateId(states, count);
+        snapshot->size = queue ? queue->save(snapshot->events) : 0;
+        snapshot->check = snapshotChecksum(
+            &(snapshot->version),
+            sizeof(Snapshot<EventType, MAX_EVENTS>) - 1
+        );
+    }
+
+
+    // Restores the machine and queue from the snapshot.
+    // Returns false (and changes nothing) if the snapshot is corrupt, was
+    // saved with a different `version`, or has an unknown state id.
+    // Otherwise the machine doesn't need to be init()ed.
+    template <class EventType, uint8_t MAX_EVENTS>
+    bool restoreSnapshot(
+            const Snapshot<EventType, MAX_EVENTS>* snapshot,
+            uint8_t version,
+            FSM* machine,
+            const State* states,
+            uint8_t count,
+            QueueRingBuffer<EventType, MAX_EVENTS>* queue
+    ) {
+        if (snapshot->version != version) {
+            return false;
+        }
+        if (snapshot->size > MAX_EVENTS) {
+            return false;
+        }
+        if (snapshot->check != snapshotChecksum(
+                    &(snapshot->version),
+                    sizeof(Snapshot<EventType, MAX_EVENTS>) - 1)) {
+            return false;
+        }
+        if (!machine->resume(states, count, snapshot->state)) {
+            return false;
+        }
+        if (queue) {
+            queue->restore(snapshot->events, snapshot->size);
+        }
+        return true;
+    }
+
+
+
+    //----------------------------------------------------------------------
+    // Time Events and Idling
+    // These let a sketch sleep until either the next time event is due or a
+    // producer (such as an interrupt handler) posts an event, instead of
+    // polling the queue over and over.
+    //
+
+    // Time is measured in "ticks" of a clock which is provided by the
+    // sketch, for example a function which returns millis().
+    typedef uint32_t Ticks;
+    typedef Ticks (*Clock)();
+
+
+    // An event which is posted to a queue once its deadline has passed,
+    // and (optionally) again every `interval` ticks after that.
+    // Only the Event part is copied into the queue.
+    class TimeEvent : public Event {
+        protected:
+            IQueue*     m_queue;
+            TimeEvent*  m_next;     // next in the TimeEventList
+            Ticks       m_deadline;
+            Ticks       m_interval; // 0 if not periodic
+            bool        m_armed;
+            friend class TimeEventList;
+
+        public:
+            TimeEvent(uint8_t signal, IQueue* queue);
+
+            // Starts the time event, so that it is posted `delay` ticks
+            // after `now`, and then every `interval` ticks (if not 0).
+            void arm(Ticks now, Ticks delay, Ticks interval = 0);
+
+            // Stops the time event, so that it isn't posted.
+            void disarm();
+
+            bool armed() const {
+                return m_armed;
+            }
+    };
+
+
+    // The set of time events which are checked by dispatchAllOrWait().
+    class TimeEventList {
+        protected:
+            TimeEvent*  m_first;
+
+        public:
+            TimeEventList();
+
+            // Adds the time event to the list (whether or not it's armed).
+            void add(TimeEvent* timeEvent);
+
+            // Posts all the armed time events whose deadline has passed.
+            // Returns the number of ticks until the next deadline, or
+            // TW_TICKS_FOREVER if no time events are armed.
+            Ticks post(Ticks now);
+    };
+
+
+    // Interface for blocking until there is something to do.
+    class IWaiter {
+        public:
+            // Blocks until notify() is called or `timeout` ticks have passed
+            // (TW_TICKS_FOREVER means no timeout). If notify() was called
+            // since the last wait() then this returns right away.
+            // This may also return early, in which case the caller just
+            // checks the queue and time events again.
+            virtual void wait(Ticks timeout) = 0;
+
+            // Called by producers after they post an event. This can be
+            // called from interrupt handlers and other threads.
+            virtual void notify() = 0;
+
+            virtual ~IWaiter() {}
+    };
+
+
+#if defined(ARDUINO) && (defined(__arm__) || defined(__AVR__))
+    // Waits by putting the CPU to sleep until the next interrupt (WFI on
+    // ARM, the SLEEP instruction on AVR).
+    // With a `clock` (the one passed to dispatchAllOrWait()) wait() goes
+    // back to sleep after each interrupt until notify() is called or the
+    // timeout has passed. Without one the timeout isn't used and wait()
+    // returns after the first interrupt (such as the one that drives
+    // millis()), which is at most a tick early.
+    class WaiterSleep : public IWaiter {
+        protected:
+            volatile bool   m_notified;
+            Clock           m_clock;
+
+            // Sleeps until the next interrupt unless notify() has been
+            // called, returns whether it had been (and clears it).
+            bool sleepOnce();
+
+        public:
+            WaiterSleep(Clock clock = 0) : m_notified(false), m_clock(clock) {}
+            virtual void wait(Ticks timeout);
+            virtual void notify() {
+                m_notified = true;
+            }
+    };
+#endif
+
+
+    // Posts the time events which are due, then dispatches all events in
+    // the queue to the state machine. If there were none it dispatches
+    // SIG_IDLE (if `idleIfEmpty` is true) and then waits until the next
+    // time event is due or a producer notifies the waiter.
+    // This is meant to be called repeatedly from loop(). The `timeEvents`
+    // can be 0 if there aren't any.
+    void dispatchAllOrWait(
+            FSM* machine,
+            IQueue* queue,
+            bool idleIfEmpty,
+            TimeEventList* timeEvents,
+            Clock clock,
+            IWaiter* waiter
+    );
+
+
+
+    //----------------------------------------------------------------------
+    // Latency
+    // Measures how long events wait in the queue and how long the machine
+    // takes to handle them, per signal.
+    //
+
+    // Counts of times, bucketed by their log2 so the memory is fixed.
+    // Bucket 0 counts times of 0 ticks, and bucket b counts times from
+    // 2^(b-1) up to 2^b - 1 ticks.  Each count stops at the largest `Count`,
+    // and `Total` is big enough for the sum of the counts.
+    template <class Count, class Total, uint8_t BUCKETS>
+    struct LatencyBuckets {
+        Count       buckets[BUCKETS];
+
+        LatencyBuckets() {
+            clear();
+        }
+
+        void clear() {
+            memset(buckets, 0, sizeof(buckets));
+        }
+
+        void record(Ticks ticks) {
+            uint8_t bucket = 0;
+            while (ticks && bucket < BUCKETS - 1) {
+                ticks >>= 1;
+                bucket++;
+            }
+            if (buckets[bucket] != Count(~Count(0))) {
+                buckets[bucket]++;
+            }
+        }
+
+        Total count() const {
+            Total total = 0;
+            for (uint8_t bucket = 0; bucket < BUCKETS; bucket++) {
+                total += buckets[bucket];
+            }
+            return total;
+        }
+
+        // Returns (an upper bound of) the time under which `percent` of the
+        // recorded times were, or TW_TICKS_FOREVER if that is in the last
+        // bucket.  Returns 0 if nothing was recorded.
+        Ticks percentile(uint8_t percent) const {
+            Total wanted = (count() * percent + 99) / 100;
+            Total seen = 0;
+            for (uint8_t bucket = 0; bucket < BUCKETS; bucket++) {
+                seen += buckets[bucket];
+                if (seen && seen >= wanted) {
+                    if (bucket == BUCKETS - 1) {
+                        return TW_TICKS_FOREVER;
+                    }
+                    return (Ticks(1) << bucket) - 1;
+                }
+            }
+            return 0;
+        }
+    };
+
+    // the histogram which LatencyMonitor keeps, whose counts stop at 65535
+    struct LatencyHistogram : public LatencyBuckets<uint16_t, uint32_t, TRIMWRIGHT_LATENCY_BUCKETS> {};
+
+
+    // Called when a machine takes longer than the budget to handle an event.
+    typedef void (*OverrunHandler)(const FSM* machine, const Event* event, Ticks took);
+
+
+    // The histograms of one machine, for the signals from `firstSignal` to
+    // `firstSignal + signals - 1` (other signals aren't recorded).
+    // The arrays of `signals` histograms are provided by the sketch, and
+    // either can be 0 if that time isn't wanted.
+    class LatencyMonitor {
+        protected:
+            Clock               m_clock;
+            LatencyHistogram*   m_waits;
+            LatencyHistogram*   m_steps;
+            uint8_t             m_firstSignal;
+            uint8_t             m_signals;
+            Ticks               m_budget;
+            OverrunHandler      m_overrunHandler;
+            uint16_t            m_overruns;
+
+        public:
+            LatencyMonitor(Clock clock, LatencyHistogram* waits, LatencyHistogram* steps, uint8_t firstSignal, uint8_t signals);
+
+            // Handling an event which takes more than `budget` ticks is
+            // counted as an overrun, and passed to the handler (if any).
+            void setBudget(Ticks budget, OverrunHandler handler = 0);
+            uint16_t overruns() const { return m_overruns; }
+
+            // The histograms of time spent waiting in the queue, and of
+            // time spent in dispatch(). Returns 0 if that signal isn't
+            // recorded.
+            LatencyHistogram* waits(uint8_t signal);
+            LatencyHistogram* steps(uint8_t signal);
+
+            Clock clock() const { return m_clock; }
+            void record(const FSM* machine, const Event* event, Ticks wait, Ticks step);
+    };
+
+
+    // Decorates another queue, remembering when each event was pushed.
+    // Events need to be pushed through this (instead of directly into the
+    // queue it decorates) for the timestamps to line up.
+    class QueueTimestampedCore : public IQueue {
+        protected:
+            IQueue*     m_queue;
+            Clock       m_clock;
+            Ticks*      m_stamps;
+            uint8_t     m_capacity;
+            uint8_t     m_front;
+            QueueTimestampedCore(IQueue* queue, Clock clock, Ticks* stamps, uint8_t capacity);
+
+        public:
+            // points the core at a copy's storage (see _twCopyCore())
+            void rebind(void* storage) {
+                m_stamps = (Ticks*) storage;
+            }
+
+            virtual void push_back(Event*);
+            virtual bool push_back(const Event* event, uint8_t size);
+            virtual Event* front();
+            virtual void pop_front();
+            virtual uint8_t size();
+
+            // when the front event was pushed
+            Ticks frontStamp() const;
+    };
+
+
+    // `CAPACITY` needs to be at least the capacity of the decorated queue.
+    template <uint8_t CAPACITY>
+    class QueueTimestamped : public QueueTimestampedCore {
+        protected:
+            Ticks   m_storage[CAPACITY];
+
+        public:
+            QueueTimestamped(IQueue* queue, Clock clock) :
+                    QueueTimestampedCore(queue, clock, m_storage, CAPACITY) {
+                // nothing else to do
+            }
+
+            // the copy has its own timestamps (see _twCopyCore())
+            QueueTimestamped(const QueueTimestamped& other) : QueueTimestampedCore(other) {
+                _twCopyCore<QueueTimestampedCore>(*this, m_storage, other, other.m_storage);
+            }
+
+            QueueTimestamped& operator=(const QueueTimestamped& other) {
+                _twCopyCore<QueueTimestampedCore>(*this, m_storage, other, other.m_storage);
+                return *this;
+            }
+    };
+
+
+    // Like dispatchAll(), but also records in the monitor how long each
+    // event waited in the queue and how long the machine took to handle it.
+    void dispatchAllMonitored(FSM* machine, QueueTimestampedCore* queue, LatencyMonitor* monitor);
+
+
+
+    //----------------------------------------------------------------------
+    // Rate Limiting
+    // Keeps a noisy source (such as a chattering sensor) from flooding a
+    // queue with one signal, so that the other signals still get through.
+    //
+
+    // The rate limit of one signal: on average one event every `interval`
+    // ticks, with up to `burst` at once.  An interval of 0 isn't limited.
+    struct RateLimit {
+        Ticks       interval;
+        uint8_t     burst;
+    };
+
+    // the token bucket of one signal
+    struct RateBucket {
+        Ticks       last;       // when the tokens were last counted
+        uint8_t     tokens;     // events which can be pushed now
+        uint16_t    dropped;
+    };
+
+
+    // Decorates another queue, dropping the events of each signal which
+    // arrive faster than its RateLimit allows.  The limits are for the
+    // signals from `firstSignal` to `firstSignal + signals - 1` (other
+    // signals aren't limited), and each push takes the same time no matter
+    // how many signals there are.
+    class QueueRateLimitedCore : public IQueue {
+        protected:
+            IQueue*             m_queue;
+            Clock               m_clock;
+            const RateLimit*    m_limits;
+            RateBucket*         m_buckets;
+            uint8_t             m_firstSignal;
+            uint8_t             m_signals;
+            uint16_t            m_dropped;
+
+            QueueRateLimitedCore(
+                    IQueue* queue,
+                    Clock clock,
+                    const RateLimit* limits,
+                    RateBucket* buckets,
+                    uint8_t firstSignal,
+                    uint8_t signals
+            );
+
+            // takes a token for the signal, if it has one
+            bool admit(uint8_t signal);
+
+        public:
+            // points the core at a copy's storage (see _twCopyCore())
+            void rebind(void* storage) {
+                m_buckets = (RateBucket*) storage;
+            }
+
+            virtual void push_back(Event* event);
+            virtual bool push_back(const Event* event, uint8_t size);
+            virtual Event* front();
+            virtual void pop_front();
+            virtual uint8_t size();
+
+            // the number of events which were dropped, of all signals or
+            // of just one
+            uint16_t dropped() const { return m_dropped; }
+            uint16_t dropped(uint8_t signal) const;
+    };
+
+
+    // `limits` is an array of `SIGNALS` limits, one for each signal from
+    // `firstSignal` on.  Each signal starts with a full burst.
+    template <uint8_t SIGNALS>
+    class QueueRateLimited : public QueueRateLimitedCore {
+        protected:
+            RateBucket  m_storage[SIGNALS];
+
+        public:
+            QueueRateLimited(IQueue* queue, Clock clock, const RateLimit* limits, uint8_t firstSignal) :
+                    QueueRateLimitedCore(queue, clock, limits, m_storage, firstSignal, SIGNALS) {
+                // nothing else to do
+            }
+
+            // the copy has its own buckets (see _twCopyCore())
+            QueueRateLimited(const QueueRateLimited& other) : QueueRateLimitedCore(other) {
+                _twCopyCore<QueueRateLimitedCore>(*this, m_storage, other, other.m_storage);
+            }
+
+            QueueRateLimited& operator=(const QueueRateLimited& other) {
+                _twCopyCore<QueueRateLimitedCore>(*this, m_storage, other, other.m_storage);
+                return *this;
+            }
+    };
+
 };
 
 
@@ -0,0 +1,962 @@
+/*
+Copyright 2019 Drew Folta <drew@folta.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ARDUINO
+
+#include "TrimWrightHost.h"
+#include <chrono>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+
+namespace TrimWright {
+
+
+
+    //----------------------------------------------------------------------
+    // CLOCKS
+    //
+
+    static std::chrono::steady_clock::time_point clockStart() {
+        static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+
+    Ticks
+    clockMillis() {
+        return Ticks(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - clockStart()).count());
+    }
+
+
+    Ticks
+    clockMicros() {
+        return Ticks(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - clockStart()).count());
+    }
+
+
+
+    //----------------------------------------------------------------------
+    // IDLING
+    //
+
+    WaiterCondition::WaiterCondition(uint32_t microsPerTick) :
+            m_notified(false),
+            m_microsPerTick(microsPerTick) {
+        // nothing else to do
+    }
+
+
+    void
+    WaiterCondition::wait(Ticks timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (TW_TICKS_FOREVER == timeout) {
+            m_condition.wait(lock, [this] { return m_notified; });
+        }
+        else {
+            m_condition.wait_for(
+                lock,
+                std::chrono::microseconds(uint64_t(timeout) * m_microsPerTick),
+                [this] { return m_notified; }
+            );
+        }
+        m_notified = false;
+    }
+
+
+    void
+    WaiterCondition::notify() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_notified = true;
+        }
+        m_condition.notify_one();
+    }
+
+
+
+
+    //----------------------------------------------------------------------
+    // EXECUTOR
+    //
+
+    // the worker running on this thread (if any)
+    static thread_local Executor* tw_currentExecutor = NULL;
+    static thread_local ExecutorDeque* tw_currentDeque = NULL;
+
+
+    ExecutorMachine::ExecutorMachine(FSM* machine, IQueue* queue) :
+            m_machine(machine),
+            m_queue(queue),
+            m_scheduled(false) {
+        // nothing else to do
+    }
+
+
+    ExecutorDeque::ExecutorDeque(uint32_t capacity) :
+            m_top(0),
+            m_bottom(0),
+            m_items(new std::atomic<ExecutorMachine*>[capacity]),
+            m_mask(capacity - 1) {
+        // nothing else to do
+    }
+
+
+    ExecutorDeque::~ExecutorDeque() {
+        delete[] m_items;
+    }
+
+
+    bool
+    ExecutorDeque::push(ExecutorMachine* item) {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top > m_mask) {
+            return false;
+        }
+        m_items[bottom & m_mask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+
+    ExecutorMachine*
+    ExecutorDeque::pop() {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+        if (top > bottom) {
+            // was already empty
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return NULL;
+        }
+        ExecutorMachine* item = m_items[bottom & m_mask].load(std::memory_order_relaxed);
+        if (top == bottom) {
+            // last item, race the thieves for it
+            if (! m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = NULL;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+
+    ExecutorMachine*
+    ExecutorDeque::steal() {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return NULL;
+        }
+        ExecutorMachine* item = m_items[top & m_mask].load(std::memory_order_relaxed);
+        if (! m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return NULL;
+        }
+        return item;
+    }
+
+
+    bool
+    ExecutorDeque::empty() const {
+        return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+    }
+
+
+    Executor::Executor(uint32_t workers, uint32_t dequeCapacity, uint8_t batch) :
+            m_batch(batch ? batch : 1),
+            m_injectSize(0),
+            m_epoch(0),
+            m_sleepers(0),
+            m_running(false),
+            m_scheduledCount(0) {
+        for (uint32_t w = 0; w < workers; w++) {
+            m_workers.push_back(new Worker(this, dequeCapacity));
+        }
+    }
+
+
+    Executor::~Executor() {
+        stop();
+        for (size_t w = 0; w < m_workers.size(); w++) {
+            delete m_workers[w];
+        }
+    }
+
+
+    void
+    Executor::start() {
+        if (m_running.exchange(true)) {
+            return;
+        }
+        for (size_t w = 0; w < m_workers.size(); w++) {
+            m_workers[w]->victim = uint32_t((w + 1) % m_workers.size());
+            m_workers[w]->thread = std::thread(&Executor::run, this, m_workers[w]);
+        }
+    }
+
+
+    void
+    Executor::stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_parkMutex);
+            m_running = false;
+        }
+        m_parkCondition.notify_all();
+        for (size_t w = 0; w < m_workers.size(); w++) {
+            if (m_workers[w]->thread.joinable()) {
+                m_workers[w]->thread.join();
+            }
+        }
+    }
+
+
+    bool
+    Executor::post(ExecutorMachine* machine, const Event* event, uint8_t size) {
+        bool schedule;
+        {
+            std::lock_guard<std::mutex> lock(machine->m_mutex);
+            if (!machine->m_queue->push_back(event, size)) {
+                return false;
+            }
+            schedule = ! machine->m_scheduled;
+            machine->m_scheduled = true;
+        }
+        if (schedule) {
+            m_scheduledCount++;
+            this->schedule(machine);
+        }
+        return true;
+    }
+
+
+    void
+    Executor::waitIdle() {
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idleCondition.wait(lock, [this] { return 0 == m_scheduledCount.load(); });
+    }
+
+
+    void
+    Executor::schedule(ExecutorMachine* machine) {
+        if (tw_currentExecutor != this || ! tw_currentDeque->push(machine)) {
+            std::lock_guard<std::mutex> lock(m_injectMutex);
+            m_inject.push_back(machine);
+            m_injectSize++;
+        }
+        // wake a parked worker, if there is one
+        // (a worker about to park increments m_sleepers and then checks
+        // m_epoch, so one of the two always sees the other's change)
+        m_epoch++;
+        if (m_sleepers.load()) {
+            std::lock_guard<std::mutex> lock(m_parkMutex);
+            m_parkCondition.notify_one();
+        }
+    }
+
+
+    ExecutorMachine*
+    Executor::find(Worker* worker) {
+        ExecutorMachine* machine = worker->deque.pop();
+        if (machine) {
+            return machine;
+        }
+        if (m_injectSize.load()) {
+            std::lock_guard<std::mutex> lock(m_injectMutex);
+            if (! m_inject.empty()) {
+                machine = m_inject.front();
+                m_inject.pop_front();
+                m_injectSize--;
+                return machine;
+            }
+        }
+        uint32_t count = uint32_t(m_workers.size());
+        for (uint32_t i = 0; i < count; i++) {
+            Worker* victim = m_workers[worker->victim];
+            if (victim != worker) {
+                machine = victim->deque.steal();
+                if (machine) {
+                    return machine;
+                }
+            }
+            worker->victim = (worker->victim + 1) % count;
+        }
+        return NULL;
+    }
+
+
+    void
+    Executor::run(Worker* worker) {
+        tw_currentExecutor = this;
+        tw_currentDeque = &worker->deque;
+        while (m_running.load()) {
+            uint32_t epoch = m_epoch.load();
+            ExecutorMachine* machine = find(worker);
+            if (machine) {
+                work(machine);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_parkMutex);
+            m_sleepers++;
+            while (m_running.load() && epoch == m_epoch.load()) {
+                m_parkCondition.wait(lock);
+            }
+            m_sleepers--;
+        }
+        tw_currentExecutor = NULL;
+        tw_currentDeque = NULL;
+    }
+
+
+    // Only the worker which took the machine from a deque gets here, and the
+    // machine isn't put back in a deque until this is done with it, so the
+    // machine is never dispatched by two threads at once.
+    void
+    Executor::work(ExecutorMachine* machine) {
+        std::unique_lock<std::mutex> lock(machine->m_mutex);
+        for (uint8_t dispatched = 0; machine->m_queue->size(); dispatched++) {
+            if (dispatched == m_batch) {
+                // give the other machines a turn
+                lock.unlock();
+                std::lock_guard<std::mutex> inject(m_injectMutex);
+                m_inject.push_back(machine);
+                m_injectSize++;
+                return;
+            }
+            // other threads only push to the back of the queue, so the front
+            // event stays put while it's dispatched without the lock
+            Event* event = machine->m_queue->front();
+            lock.unlock();
+            machine->m_machine->dispatch(event);
+            lock.lock();
+            machine->m_queue->pop_front();
+        }
+        machine->m_scheduled = false;
+        lock.unlock();
+        if (1 == m_scheduledCount--) {
+            std::lock_guard<std::mutex> idle(m_idleMutex);
+            m_idleCondition.notify_all();
+        }
+    }
+
+
+
+    //----------------------------------------------------------------------
+    // SHARDS
+    //
+
+    // the shard running on this thread (if any)
+    static thread_local ShardGroup* tw_currentGroup = NULL;
+    static thread_local uint32_t tw_currentShard = 0;
+
+
+    ShardMachine::ShardMachine(FSM* machine, IQueue* queue, uint32_t shard) :
+            m_machine(machine),
+            m_queue(queue),
+            m_shard(shard) {
+        // nothing else to do
+    }
+
+
+    ShardMailbox::ShardMailbox(uint8_t eventSize, uint32_t capacity) :
+            m_head(0),
+            m_tailCache(0),
+            m_tail(0),
+            m_headCache(0),
+            m_slotSize((sizeof(ShardMachine*) + eventSize + 7) & ~7u),
+            m_mask(capacity - 1),
+            m_eventSize(eventSize) {
+        m_slots = new uint8_t[m_slotSize * capacity];
+    }
+
+
+    ShardMailbox::~ShardMailbox() {
+        delete[] m_slots;
+    }
+
+
+    bool
+    ShardMailbox::push(ShardMachine* target, const Event* event, uint8_t size) {
+        if (size > m_eventSize) {
+            return false;
+        }
+        uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache > m_mask) {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache > m_mask) {
+                return false;
+            }
+        }
+        uint8_t* slot = m_slots + (tail & m_mask) * m_slotSize;
+        memcpy(slot, &target, sizeof(target));
+        memcpy(slot + sizeof(target), event, size);
+        memset(slot + sizeof(target) + size, 0, m_eventSize - size);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+
+    ShardMachine*
+    ShardMailbox::front(Event** event) {
+        uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache) {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache) {
+                return NULL;
+            }
+        }
+        uint8_t* slot = m_slots + (head & m_mask) * m_slotSize;
+        ShardMachine* target;
+        memcpy(&target, slot, sizeof(target));
+        *event = (Event*) (slot + sizeof(target));
+        return target;
+    }
+
+
+    void
+    ShardMailbox::pop_front() {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+
+    ShardGroup::ShardGroup(uint32_t shards, uint8_t eventSize, uint32_t mailboxCapacity, uint32_t batch) :
+            m_batch(batch),
+            m_eventSize(eventSize),
+            m_pin(false),
+            m_running(false) {
+        for (uint32_t s = 0; s < shards; s++) {
+            Shard* shard = new Shard();
+            shard->dispatched = 0;
+            m_shards.push_back(shard);
+            m_externalMutexes.push_back(new std::mutex());
+        }
+        for (uint32_t m = 0; m < (shards + 1) * shards; m++) {
+            m_mailboxes.push_back(new ShardMailbox(eventSize, mailboxCapacity));
+        }
+    }
+
+
+    ShardGroup::~ShardGroup() {
+        stop();
+        for (size_t s = 0; s < m_shards.size(); s++) {
+            for (size_t m = 0; m < m_shards[s]->machines.size(); m++) {
+                delete m_shards[s]->machines[m];
+            }
+            delete m_shards[s];
+            delete m_externalMutexes[s];
+        }
+        for (size_t m = 0; m < m_mailboxes.size(); m++) {
+            delete m_mailboxes[m];
+        }
+    }
+
+
+    ShardMachine*
+    ShardGroup::add(uint32_t shard, FSM* machine, IQueue* queue) {
+        ShardMachine* entry = new ShardMachine(machine, queue, shard);
+        m_shards[shard]->machines.push_back(entry);
+        return entry;
+    }
+
+
+    void
+    ShardGroup::start(bool pin) {
+        if (m_running.exchange(true)) {
+            return;
+        }
+        m_pin = pin;
+        for (uint32_t s = 0; s < m_shards.size(); s++) {
+            m_shards[s]->thread = std::thread(&ShardGroup::run, this, s);
+        }
+    }
+
+
+    void
+    ShardGroup::stop() {
+        m_running = false;
+        for (size_t s = 0; s < m_shards.size(); s++) {
+            if (m_shards[s]->thread.joinable()) {
+                m_shards[s]->thread.join();
+            }
+        }
+    }
+
+
+    bool
+    ShardGroup::post(ShardMachine* target, Event* event) {
+        return post(target, event, sizeof(Event));
+    }
+
+
+    bool
+    ShardGroup::post(ShardMachine* target, const Event* event, uint8_t size) {
+        if (size > m_eventSize) {
+            return false;
+        }
+        uint32_t count = uint32_t(m_shards.size());
+        if (tw_currentGroup == this) {
+            if (tw_currentShard == target->m_shard) {
+                // same shard, so only this thread touches the queue
+                return target->m_queue->push_back(event, size);
+            }
+            return m_mailboxes[tw_currentShard * count + target->m_shard]->push(target, event, size);
+        }
+        std::lock_guard<std::mutex> lock(*m_externalMutexes[target->m_shard]);
+        return m_mailboxes[count * count + target->m_shard]->push(target, event, size);
+    }
+
+
+    // Moves up to m_batch events from the mailbox into their machines' queues.
+    // Returns whether any were moved.
+    bool
+    ShardGroup::drain(ShardMailbox* mailbox) {
+        uint32_t moved = 0;
+        Event* event;
+        while (moved < m_batch) {
+            ShardMachine* target = mailbox->front(&event);
+            if (! target) {
+                break;
+            }
+            if (!target->m_queue->push_back(event, m_eventSize)) {
+                // queue is full, leave the rest (in order) for the next pass
+                break;
+            }
+            mailbox->pop_front();
+            moved++;
+        }
+        return moved;
+    }
+
+
+    void
+    ShardGroup::run(uint32_t index) {
+#ifdef __linux__
+        uint32_t cores = std::thread::hardware_concurrency();
+        if (m_pin && cores) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(index % cores, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+#endif
+        tw_currentGroup = this;
+        tw_currentShard = index;
+        Shard* shard = m_shards[index];
+        uint32_t count = uint32_t(m_shards.size());
+        while (m_running.load(std::memory_order_relaxed)) {
+            bool busy = false;
+            for (uint32_t from = 0; from <= count; from++) {
+                if (from != index && drain(m_mailboxes[from * count + index])) {
+                    busy = true;
+                }
+            }
+            for (size_t m = 0; m < shard->machines.size(); m++) {
+                ShardMachine* machine = shard->machines[m];
+                // only the events which were there at the start of the pass,
+                // so a machine posting to itself can't hold up the mailboxes
+                uint8_t pending = machine->m_queue->size();
+                busy = busy || pending;
+                while (pending--) {
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    machine->m_machine->dispatch(machine->m_queue->front());
+                    machine->m_queue->pop_front();
+                    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+                    shard->latency.record(ns < TW_TICKS_FOREVER ? Ticks(ns) : TW_TICKS_FOREVER);
+                    shard->dispatched++;
+                }
+            }
+            if (! busy) {
+                std::this_thread::yield();
+            }
+        }
+        tw_currentGroup = NULL;
+    }
+
+
+    uint32_t
+    ShardGroup::latency(uint32_t index, uint8_t percent) const {
+        return m_shards[index]->latency.percentile(percent);
+    }
+
+
+    uint64_t
+    ShardGroup::dispatched(uint32_t index) const {
+        return m_shards[index]->dispatched;
+    }
+
+
+
+    //----------------------------------------------------------------------
+    // REGISTRY
+    // route() groups the batch with a linked list of events per id (through
+    // m_next), which is O(batch) no matter how many machines there are.
+    //
+
+    #define TW_ROUTE_NONE 0xFFFFFFFF
+
+    MachineRegistry::MachineRegistry() : m_count(0) {}
+
+
+    uint32_t
+    MachineRegistry::add(FSM* machine) {
+        uint32_t id;
+        if (m_free.empty()) {
+            id = m_slots.size();
+            Slot slot = { machine, TW_ROUTE_NONE, TW_ROUTE_NONE };
+            m_slots.push_back(slot);
+        }
+        else {
+            id = m_free.back();
+            m_free.pop_back();
+            m_slots[id].machine = machine;
+        }
+        m_count++;
+        return id;
+    }
+
+
+    void
+    MachineRegistry::remove(uint32_t id) {
+        if (! get(id)) {
+            return;
+        }
+        m_slots[id].machine = NULL;
+        m_free.push_back(id);
+        m_count--;
+    }
+
+
+    uint32_t
+    MachineRegistry::route(const RoutedEvent* events, uint32_t count) {
+        if (m_next.size() < count) {
+            m_next.resize(count);
+        }
+        m_touched.clear();
+        uint32_t slots = m_slots.size();
+        for (uint32_t e = 0; e < count; e++) {
+            uint32_t id = events[e].id;
+            if (id >= slots) {
+                continue;
+            }
+            Slot* slot = &m_slots[id];
+            if (! slot->machine) {
+                continue;
+            }
+            m_next[e] = TW_ROUTE_NONE;
+            if (TW_ROUTE_NONE == slot->head) {
+                slot->head = e;
+                m_touched.push_back(id);
+            }
+            else {
+                m_next[slot->tail] = e;
+            }
+            slot->tail = e;
+        }
+        uint32_t dispatched = 0;
+        for (uint32_t t = 0; t < m_touched.size(); t++) {
+            Slot* slot = &m_slots[m_touched[t]];
+            for (uint32_t e = slot->head; e != TW_ROUTE_NONE; e = m_next[e]) {
+                slot->machine->dispatch(events[e].event);
+                dispatched++;
+            }
+            slot->head = TW_ROUTE_NONE;
+        }
+        return dispatched;
+    }
+
+
+#ifdef __linux__
+    //----------------------------------------------------------------------
+    // SHARED MEMORY QUEUE
+    // This is Dmitry Vyukov's bounded queue: each slot has a sequence
+    // number which says whether it is free for the producer at a position
+    // (== position) or has been committed (== position + 1).
+    //
+
+    #define TW_SHARED_MAGIC 0x54575351      // "TWSQ"
+
+    struct QueueShared::Header {
+        std::atomic<uint32_t>               magic;      // set once the queue is ready
+        uint8_t                             eventSize;
+        uint8_t                             capacity;
+        alignas(64) std::atomic<uint32_t>   tail;       // next position to reserve
+        alignas(64) std::atomic<uint32_t>   head;       // position of the front event
+        std::atomic<uint32_t>               wakes;      // the futex
+        std::atomic<uint32_t>               sleeping;   // the consumer is (about to be) in wait()
+    };
+
+
+    static long
+    tw_futex(std::atomic<uint32_t>* word, int op, uint32_t value, const struct timespec* timeout) {
+        return syscall(SYS_futex, (uint32_t*) word, op, value, timeout, NULL, 0);
+    }
+
+
+    QueueShared::QueueShared(const char* name, uint8_t eventSize, uint8_t capacity, bool create, uint32_t microsPerTick) :
+            m_header(NULL),
+            m_slots(NULL),
+            m_slotSize((8 + eventSize + 7) & ~7u),     // sequence number, then the event at offset 8
+            m_mask(capacity - 1),
+            m_mapSize(0),
+            m_ready(0),
+            m_woken(0),
+            m_microsPerTick(microsPerTick),
+            m_owner(create) {
+        snprintf(m_name, sizeof(m_name), "%s", name);
+        uint32_t headerSize = (sizeof(Header) + 63) & ~63u;
+        m_mapSize = headerSize + m_slotSize * capacity;
+        int fd;
+        if (create) {
+            shm_unlink(m_name);
+            fd = shm_open(m_name, O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0) {
+                return;
+            }
+            if (ftruncate(fd, m_mapSize) < 0) {
+                close(fd);
+                shm_unlink(m_name);
+                return;
+            }
+        }
+        else {
+            fd = shm_open(m_name, O_RDWR, 0);
+            if (fd < 0) {
+                return;
+            }
+            struct stat info;
+            if (fstat(fd, &info) < 0 || info.st_size != off_t(m_mapSize)) {
+                close(fd);
+                return;
+            }
+        }
+        void* map = mmap(NULL, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == map) {
+            if (create) {
+                shm_unlink(m_name);
+            }
+            return;
+        }
+        Header* header = (Header*) map;
+        m_slots = (uint8_t*) map + headerSize;
+        if (create) {
+            new (header) Header();
+            header->eventSize = eventSize;
+            header->capacity = capacity;
+            header->tail.store(0);
+            header->head.store(0);
+            header->wakes.store(0);
+            header->sleeping.store(0);
+            for (uint32_t position = 0; position < capacity; position++) {
+                new (slot(position)) std::atomic<uint32_t>(position);
+            }
+            header->magic.store(TW_SHARED_MAGIC, std::memory_order_release);
+        }
+        else if (
+            header->magic.load(std::memory_order_acquire) != TW_SHARED_MAGIC ||
+            header->eventSize != eventSize ||
+            header->capacity != capacity
+        ) {
+            munmap(map, m_mapSize);
+            return;
+        }
+        m_header = header;
+        m_woken = header->wakes.load();
+    }
+
+
+    QueueShared::~QueueShared() {
+        if (m_header) {
+            munmap(m_header, m_mapSize);
+            if (m_owner) {
+                shm_unlink(m_name);
+            }
+        }
+    }
+
+
+    uint8_t*
+    QueueShared::slot(uint32_t position) const {
+        return m_slots + (position & m_mask) * m_slotSize;
+    }
+
+
+    Event*
+    QueueShared::reserve() {
+        uint32_t position = m_header->tail.load(std::memory_order_relaxed);
+        for (;;) {
+            std::atomic<uint32_t>* sequence = (std::atomic<uint32_t>*) slot(position);
+            int32_t diff = int32_t(sequence->load(std::memory_order_acquire) - position);
+            if (0 == diff) {
+                if (m_header->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    return (Event*) (slot(position) + 8);
+                }
+            }
+            else if (diff < 0) {
+                // the consumer hasn't freed this slot yet
+                return NULL;
+            }
+            else {
+                position = m_header->tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    void
+    QueueShared::commit(Event* reserved) {
+        // The slot's sequence number is still its position (nobody else
+        // touches it until it's committed), so each producer commits the
+        // slot it reserved without any state in this object.
+        std::atomic<uint32_t>* sequence = (std::atomic<uint32_t>*) ((uint8_t*) reserved - 8);
+        uint32_t position = sequence->load(std::memory_order_relaxed);
+        sequence->store(position + 1, std::memory_order_release);
+        // pairs with the fence in wait()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // only the first producer to see the consumer asleep wakes it
+        if (m_header->sleeping.load(std::memory_order_relaxed) && m_header->sleeping.exchange(0)) {
+            notify();
+        }
+    }
+
+
+    void
+    QueueShared::push_back(Event* event) {
+        push_back(event, sizeof(Event));
+    }
+
+
+    bool
+    QueueShared::push_back(const Event* event, uint8_t size) {
+        if (size > m_header->eventSize) {
+            return false;
+        }
+        Event* reserved = reserve();
+        if (!reserved) {
+            return false;
+        }
+        memcpy(reserved, event, size);
+        memset((uint8_t*) reserved + size, 0, m_header->eventSize - size);
+        commit(reserved);
+        return true;
+    }
+
+
+    Event*
+    QueueShared::front() {
+        uint32_t head = m_header->head.load(std::memory_order_relaxed);
+        std::atomic<uint32_t>* sequence = (std::atomic<uint32_t>*) slot(head);
+        if (sequence->load(std::memory_order_acquire) != head + 1) {
+            // nothing has been committed at the front
+            return NULL;
+        }
+        return (Event*) (slot(head) + 8);
+    }
+
+
+    void
+    QueueShared::pop_front() {
+        uint32_t head = m_header->head.load(std::memory_order_relaxed);
+        std::atomic<uint32_t>* sequence = (std::atomic<uint32_t>*) slot(head);
+        if (sequence->load(std::memory_order_acquire) != head + 1) {
+            // nothing to pop
+            return;
+        }
+        sequence->store(head + m_header->capacity, std::memory_order_release);
+        m_header->head.store(head + 1, std::memory_order_relaxed);
+        if (m_ready) {
+            m_ready--;
+        }
+    }
+
+
+    uint8_t
+    QueueShared::size() {
+        // Events are only counted once they're committed, and producers
+        // can commit out of order, so count the committed ones at the front.
+        uint32_t head = m_header->head.load(std::memory_order_relaxed);
+        while (m_ready < m_header->capacity) {
+            uint32_t position = head + m_ready;
+            std::atomic<uint32_t>* sequence = (std::atomic<uint32_t>*) slot(position);
+            if (sequence->load(std::memory_order_acquire) != position + 1) {
+                break;
+            }
+            m_ready++;
+        }
+        return uint8_t(m_ready);
+    }
+
+
+    void
+    QueueShared::wait(Ticks timeout) {
+        uint32_t wakes = m_header->wakes.load();
+        if (wakes != m_woken) {
+            // notified since the last wait()
+            m_woken = wakes;
+            return;
+        }
+        m_header->sleeping.store(1, std::memory_order_relaxed);
+        // pairs with the fence in commit()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (0 == size()) {
+            if (TW_TICKS_FOREVER == timeout) {
+                tw_futex(&m_header->wakes, FUTEX_WAIT, wakes, NULL);
+            }
+            else {
+                uint64_t micros = uint64_t(timeout) * m_microsPerTick;
+                struct timespec relative;
+                relative.tv_sec = time_t(micros / 1000000);
+                relative.tv_nsec = long(micros % 1000000) * 1000;
+                tw_futex(&m_header->wakes, FUTEX_WAIT, wakes, &relative);
+            }
+        }
+        m_header->sleeping.store(0, std::memory_order_relaxed);
+        m_woken = m_header->wakes.load();
+    }
+
+
+    void
+    QueueShared::notify() {
+        m_header->wakes.fetch_add(1);
+        tw_futex(&m_header->wakes, FUTEX_WAKE, 1, NULL);
+    }
+#endif
+
+
+};
+
+
+#endif
@@ -0,0 +1,479 @@
+/*
+Copyright 2019 Drew Folta <drew@folta.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Things which are only useful when running TrimWright on a host computer
+// (for example Linux) instead of a microcontroller.
+
+#ifndef TRIMWRIGHT_HOST_H
+#define TRIMWRIGHT_HOST_H
+#ifndef ARDUINO
+
+#include "TrimWright.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TrimWright {
+
+
+    //----------------------------------------------------------------------
+    // Clocks
+    // These can be used as a TrimWright::Clock.
+    //
+
+    // milliseconds since the first call
+    Ticks clockMillis();
+
+    // microseconds since the first call
+    Ticks clockMicros();
+
+
+
+    //----------------------------------------------------------------------
+    // Idling
+    //
+
+    // Waits using a condition variable, so that the thread uses no CPU
+    // until notify() is called (from another thread) or the timeout passes.
+    class WaiterCondition : public IWaiter {
+        protected:
+            std::mutex              m_mutex;
+            std::condition_variable m_condition;
+            bool                    m_notified;
+            uint32_t                m_microsPerTick;
+
+        public:
+            // `microsPerTick` needs to match the clock which is used with
+            // dispatchAllOrWait(), for example 1000 for clockMillis().
+            WaiterCondition(uint32_t microsPerTick = 1000);
+            virtual void wait(Ticks timeout);
+            virtual void notify();
+    };
+
+
+
+    //----------------------------------------------------------------------
+    // Queues
+    //
+
+    // A QueueDoubleBuffer for producers on other threads, which take a mutex
+    // for each push while the consumer only takes it once per batch.
+    template <class EventType, uint8_t MAX_EVENTS>
+    class QueueDoubleBufferMutex : public QueueDoubleBuffer<EventType, MAX_EVENTS> {
+        protected:
+            std::mutex  m_mutex;
+
+            virtual bool pushLocked(const void* event, uint8_t size) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return this->pushUnlocked(event, size);
+            }
+
+            virtual void swapLocked() {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                this->swapUnlocked();
+            }
+    };
+
+
+
+    //----------------------------------------------------------------------
+    // Executor
+    // Runs many machines (each with its own queue) on a pool of worker
+    // threads.  A machine which has events is scheduled on one worker's
+    // deque, and idle workers steal from the other workers' deques.
+    //
+
+    // A machine and its queue, as run by an Executor.
+    // The machine needs to be init()ed before any events are posted to it.
+    class ExecutorMachine {
+        protected:
+            friend class Executor;
+            FSM*        m_machine;
+            IQueue*     m_queue;
+            std::mutex  m_mutex;        // guards m_queue and m_scheduled
+            bool        m_scheduled;    // is waiting in a deque or being dispatched
+
+        public:
+            ExecutorMachine(FSM* machine, IQueue* queue);
+    };
+
+
+    // A fixed-capacity Chase-Lev work-stealing deque.
+    // Only the owning worker calls push() and pop() (at the bottom),
+    // any thread can call steal() (from the top).
+    class ExecutorDeque {
+        protected:
+            std::atomic<int64_t>            m_top;
+            std::atomic<int64_t>            m_bottom;
+            std::atomic<ExecutorMachine*>*  m_items;
+            int64_t                         m_mask;
+
+        public:
+            // `capacity` needs to be a power of two
+            ExecutorDeque(uint32_t capacity);
+            ~ExecutorDeque();
+            bool push(ExecutorMachine*);    // false if full
+            ExecutorMachine* pop();         // NULL if empty
+            ExecutorMachine* steal();       // NULL if empty (or lost a race)
+            bool empty() const;
+    };
+
+
+    class Executor {
+        protected:
+            struct Worker {
+                Executor*       executor;
+                ExecutorDeque   deque;
+                std::thread     thread;
+                uint32_t        victim;     // where to start looking to steal
+                Worker(Executor* e, uint32_t capacity) : executor(e), deque(capacity), victim(0) {}
+            };
+            std::vector<Worker*>            m_workers;
+            uint8_t                         m_batch;
+
+            // machines posted by threads which aren't workers (and overflow)
+            std::mutex                      m_injectMutex;
+            std::deque<ExecutorMachine*>    m_inject;
+            std::atomic<uint32_t>           m_injectSize;
+
+            // parking of idle workers
+            std::mutex                      m_parkMutex;
+            std::condition_variable         m_parkCondition;
+            std::atomic<uint32_t>           m_epoch;        // changes whenever work is added
+            std::atomic<uint32_t>           m_sleepers;
+            std::atomic<bool>               m_running;
+
+            // for waitIdle()
+            std::atomic<uint32_t>           m_scheduledCount;
+            std::mutex                      m_idleMutex;
+            std::condition_variable         m_idleCondition;
+
+            void schedule(ExecutorMachine*);
+            ExecutorMachine* find(Worker*);
+            void run(Worker*);
+            void work(ExecutorMachine*);
+
+        public:
+            // `workers` threads are started by start().
+            // `dequeCapacity` (a power of two) is the number of machines each
+            // worker can have scheduled before they overflow to a shared list.
+            // Each time a machine is run it is dispatched at most `batch`
+            // events, so that one busy machine can't starve the others.
+            Executor(uint32_t workers, uint32_t dequeCapacity = 1024, uint8_t batch = 16);
+            ~Executor();
+
+            void start();
+
+            // Stops the workers once they finish the machine they are running.
+            // Events which haven't been dispatched yet stay in their queues.
+            void stop();
+
+            // Adds `size` bytes of the event to the machine's queue (see
+            // IQueue::push_back()) and schedules the machine.
+            // Can be called from any thread, including from inside a handler.
+            // Returns false if the queue was full.
+            bool post(ExecutorMachine*, const Event*, uint8_t size = sizeof(Event));
+
+            // Blocks until every machine's queue is empty.
+            void waitIdle();
+    };
+
+
+
+    //----------------------------------------------------------------------
+    // Shards
+    // Each shard is a thread (pinned to a core) which owns a fixed group of
+    // machines.  Posting to a machine on the same shard pushes straight into
+    // its queue, and posting to a machine on another shard goes through a
+    // single-producer single-consumer mailbox for that pair of shards.
+    //
+
+    // A machine and its queue, as owned by one shard of a ShardGroup.
+    class ShardMachine {
+        protected:
+            friend class ShardGroup;
+            FSM*        m_machine;
+            IQueue*     m_queue;
+            uint32_t    m_shard;
+            ShardMachine(FSM* machine, IQueue* queue, uint32_t shard);
+    };
+
+
+    // A lock-free single-producer single-consumer ring of (target, event).
+    // The consumer's and producer's members are padded a cache line apart
+    // by hand, since `new` doesn't honor alignas(64) before C++17.
+    class ShardMailbox {
+        protected:
+            std::atomic<uint32_t>   m_head;     // written by the consumer
+            uint32_t                m_tailCache;
+            uint8_t                 m_consumerPad[64 - 2 * sizeof(uint32_t)];
+            std::atomic<uint32_t>   m_tail;     // written by the producer
+            uint32_t                m_headCache;
+            uint8_t                 m_producerPad[64 - 2 * sizeof(uint32_t)];
+            uint8_t*                m_slots;
+            uint32_t                m_slotSize;
+            uint32_t                m_mask;
+            uint8_t                 m_eventSize;
+
+        public:
+            // `capacity` needs to be a power of two
+            ShardMailbox(uint8_t eventSize, uint32_t capacity);
+            ~ShardMailbox();
+
+            // producer, copies `size` bytes of the event (and zeros the rest
+            // of the slot), returns false if it's full or `size` is too big
+            bool push(ShardMachine* target, const Event* event, uint8_t size);
+
+            // consumer, returns NULL if empty
+            ShardMachine* front(Event** event);
+            void pop_front();
+    };
+
+
+    class ShardGroup {
+        protected:
+            struct Shard {
+                std::vector<ShardMachine*>  machines;
+                std::thread                 thread;
+                // dispatch times in nanoseconds (the last bucket is 2^31 or more)
+                LatencyBuckets<uint64_t, uint64_t, 33> latency;
+                uint64_t                    dispatched;
+            };
+            std::vector<Shard*>             m_shards;
+            // mailboxes[from * shards + to], plus a last row for posts from
+            // other threads (whose producer side is guarded by a mutex)
+            std::vector<ShardMailbox*>      m_mailboxes;
+            std::vector<std::mutex*>        m_externalMutexes;
+            uint32_t                        m_batch;
+            uint8_t                         m_eventSize;
+            bool                            m_pin;
+            std::atomic<bool>               m_running;
+
+            bool drain(ShardMailbox*);
+            void run(uint32_t shard);
+
+        public:
+            // `eventSize` is the size of the events which are posted (they
+            // all need to be the same type as the queues hold).
+            // `mailboxCapacity` (a power of two) is the number of events
+            // waiting between each pair of shards, and up to `batch` of them
+            // are moved into the machines' queues at the start of each pass.
+            ShardGroup(uint32_t shards, uint8_t eventSize, uint32_t mailboxCapacity = 256, uint32_t batch = 64);
+            ~ShardGroup();
+
+            // Adds a machine to a shard.  This needs to be done before start().
+            // The machine needs to be init()ed before any events are posted to it.
+            ShardMachine* add(uint32_t shard, FSM* machine, IQueue* queue);
+
+            // Starts one thread per shard, pinned to a core if `pin` is true
+            // (and the platform supports it).
+            void start(bool pin = true);
+            void stop();
+
+            // Posts the event to the machine, can be called from any thread.
+            // Returns false if the machine's queue or the mailbox was full.
+            // Like the queues, this only copies the Event part of the event.
+            bool post(ShardMachine* target, Event* event);
+
+            // copies `size` bytes of the event (up to `eventSize`)
+            bool post(ShardMachine* target, const Event* event, uint8_t size);
+
+            // Returns (an upper bound of) the dispatch time, in nanoseconds,
+            // under which `percent` of the shard's dispatches took.
+            // This should be called after stop().
+            uint32_t latency(uint32_t shard, uint8_t percent) const;
+
+            // number of events dispatched by the shard
+            uint64_t dispatched(uint32_t shard) const;
+    };
+
+
+
+    //----------------------------------------------------------------------
+    // Registry
+    // Gives machines compact ids, so that events tagged with an id (for
+    // example one machine per network session) can be routed in batches.
+    //
+
+    // An event and the id of the machine it's for.
+    struct RoutedEvent {
+        uint32_t        id;
+        const Event*    event;
+    };
+
+
+    class MachineRegistry {
+        protected:
+            struct Slot {
+                FSM*        machine;    // NULL if not used
+                uint32_t    head;       // route(): first event in the batch
+                uint32_t    tail;       // route(): last event in the batch
+            };
+            std::vector<Slot>       m_slots;        // by id
+            std::vector<uint32_t>   m_free;         // ids to reuse
+            uint32_t                m_count;
+
+            // for route(), kept so that it doesn't allocate
+            std::vector<uint32_t>   m_next;         // by event, next event for the same id
+            std::vector<uint32_t>   m_touched;      // ids which have events in the batch
+
+        public:
+            MachineRegistry();
+
+            // Returns the id of the machine, reusing the ids of removed machines.
+            uint32_t add(FSM* machine);
+            void remove(uint32_t id);
+
+            // returns NULL if there's no machine with the id
+            FSM* get(uint32_t id) const {
+                return id < m_slots.size() ? m_slots[id].machine : NULL;
+            }
+
+            // number of machines
+            uint32_t size() const { return m_count; }
+
+            // Dispatches a batch of events, grouped by machine so that each
+            // machine is dispatched all of its events (in the order they are
+            // in the batch) in one go, while it's in the cache.  The machines
+            // are dispatched in the order of their first event in the batch.
+            // Events for ids without a machine are skipped, and machines
+            // shouldn't be added or removed by handlers during the batch.
+            // Returns the number of events which were dispatched.
+            uint32_t route(const RoutedEvent* events, uint32_t count);
+    };
+
+
+    // A registry which also holds the machines, in chunks of `CHUNK`
+    // machines, so that machines with nearby ids are nearby in memory.
+    // The id of a machine is its position in the slab, so machines should
+    // only be added with create() (not add()).
+    template <class Machine, uint32_t CHUNK = 1024>
+    class MachineSlab : public MachineRegistry {
+        protected:
+            std::vector<Machine*>   m_chunks;
+
+        public:
+            ~MachineSlab() {
+                for (uint32_t c = 0; c < m_chunks.size(); c++) {
+                    delete[] m_chunks[c];
+                }
+            }
+
+            // Returns a (default constructed) machine which isn't in use,
+            // and sets `id` to its id.  The machine still needs to be init()ed.
+            Machine* create(uint32_t* id) {
+                uint32_t next = m_free.empty() ? m_slots.size() : m_free.back();
+                if (next / CHUNK >= m_chunks.size()) {
+                    m_chunks.push_back(new Machine[CHUNK]);
+                }
+                Machine* machine = &m_chunks[next / CHUNK][next % CHUNK];
+                *id = add(machine);
+                return machine;
+            }
+
+            // The machine is reset (by assigning a default constructed one)
+            // so that it's ready to be reused.
+            void destroy(uint32_t id) {
+                if (! get(id)) {
+                    return;
+                }
+                remove(id);
+                m_chunks[id / CHUNK][id % CHUNK] = Machine();
+            }
+
+            Machine* machine(uint32_t id) const {
+                return static_cast<Machine*>(get(id));
+            }
+    };
+
+
+
+#ifdef __linux__
+    //----------------------------------------------------------------------
+    // Shared Memory Queue
+    // A queue in POSIX shared memory, so that other processes can post
+    // events straight into it.  Posting doesn't make a syscall unless the
+    // consumer is asleep waiting for events.
+    //
+
+    // The consumer (the process which dispatches the events) creates the
+    // queue and the producers open it by name.  Any number of producers
+    // (processes or threads, which can share one QueueShared) can
+    // push_back() or reserve()/commit(), while only the consumer uses
+    // front(), pop_front() and size().
+    // It is also the consumer's waiter for dispatchAllOrWait().
+    // The events are copied as bytes, so they can't contain pointers.
+    class QueueShared : public IQueue, public IWaiter {
+        protected:
+            struct Header;
+            Header*     m_header;
+            uint8_t*    m_slots;
+            uint32_t    m_slotSize;
+            uint32_t    m_mask;
+            uint32_t    m_mapSize;
+            uint32_t    m_ready;        // consumer: committed events at the front
+            uint32_t    m_woken;        // consumer: the wake count when last checked
+            uint32_t    m_microsPerTick;
+            bool        m_owner;
+            char        m_name[64];
+
+            uint8_t* slot(uint32_t position) const;
+
+        public:
+            // Creates (if `create`) or opens the queue called `name` (such
+            // as "/myqueue").  `capacity` needs to be a power of two.
+            // `microsPerTick` is for wait(), see WaiterCondition.
+            QueueShared(const char* name, uint8_t eventSize, uint8_t capacity, bool create, uint32_t microsPerTick = 1000);
+            virtual ~QueueShared();
+
+            // whether the queue was created or opened
+            bool ok() const { return m_header != NULL; }
+
+            // producers
+            // (push_back(Event*) only copies the Event part, and zeros the rest)
+            virtual void push_back(Event*);
+            virtual bool push_back(const Event* event, uint8_t size);
+
+            // Returns the slot to write an event into, or NULL if full.
+            // The event is added when that slot is passed to commit().
+            Event* reserve();
+            void commit(Event* reserved);
+
+            // consumer (front() returns NULL if nothing has been committed)
+            virtual Event* front();
+            virtual void pop_front();
+            virtual uint8_t size();
+            virtual void wait(Ticks timeout);
+
+            // wakes the consumer, push_back() and commit() do this already
+            virtual void notify();
+    };
+#endif
+
+
+};
+
+
+#endif
+#endif
@@ -0,0 +1,137 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#define TRIMWRIGHT_BUBBLE_CACHE 1
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum Signals {
+    SIG_TICK = SIG_USER,
+    SIG_KEY,
+    SIG_SWITCH,
+};
+
+
+// tests/bubblestatic defines TEST_STATIC and includes this file, so the
+// same machine runs over both bases.
+#ifdef TEST_STATIC
+#define TEST_BASE HSMStatic<Machine>
+#define TEST_BUBBLE BubbleCacheStatic<Machine>
+#define TEST_STATE(s) (s)
+#else
+#define TEST_BASE HSM
+#define TEST_BUBBLE BubbleCache
+#define TEST_STATE(s) ((State) (s))
+#endif
+
+
+// TOP handles TICK, which MIDDLE and both leaves pass up.
+// KEY is handled by MIDDLE only while `locked` is false, so MIDDLE uses
+// TW_SUPER() for it (it isn't a pure pass-through).
+class Machine : public TEST_BASE {
+    public:
+        bool locked;
+
+        Machine() : locked(false) {}
+
+        void trace(const Event* event, const char* name) {
+            if (event->signal >= SIG_USER) {
+                cout << name << ";";
+            }
+        }
+
+        DispatchOutcome stateTOP(const Event* event) {
+            trace(event, "top");
+            switch (event->signal) {
+                case SIG_TICK:
+                case SIG_KEY:
+                    return TW_HANDLED();
+            }
+            return TW_SUPER(&Machine::stateROOT);
+        }
+
+        DispatchOutcome stateMIDDLE(const Event* event) {
+            trace(event, "middle");
+            switch (event->signal) {
+                case SIG_TICK:
+                    return TW_PASS(&Machine::stateTOP);
+                case SIG_KEY:
+                    if (!locked) {
+                        return TW_HANDLED();
+                    }
+                    break;
+            }
+            return TW_SUPER(&Machine::stateTOP);
+        }
+
+        DispatchOutcome stateLEFT(const Event* event) {
+            trace(event, "left");
+            switch (event->signal) {
+                case SIG_TICK:
+                case SIG_KEY:
+                    return TW_PASS(&Machine::stateMIDDLE);
+                case SIG_SWITCH:
+                    return TW_TRANSITION(&Machine::stateRIGHT);
+            }
+            return TW_SUPER(&Machine::stateMIDDLE);
+        }
+
+        DispatchOutcome stateRIGHT(const Event* event) {
+            trace(event, "right");
+            switch (event->signal) {
+                case SIG_SWITCH:
+                    return TW_TRANSITION(&Machine::stateLEFT);
+            }
+            return TW_SUPER(&Machine::stateMIDDLE);
+        }
+};
+
+
+void post(Machine* machine, uint8_t signal, const char* name) {
+    Event event;
+    event.signal = signal;
+    cout << name << ": ";
+    machine->dispatch(&event);
+    cout << endl;
+}
+
+
+void run(Machine* machine) {
+    machine->locked = false;
+    post(machine, SIG_TICK, "TICK");
+    post(machine, SIG_TICK, "TICK");
+    post(machine, SIG_KEY, "KEY");
+    post(machine, SIG_KEY, "KEY");
+    machine->locked = true;
+    post(machine, SIG_KEY, "KEY (locked)");
+    post(machine, SIG_SWITCH, "SWITCH");
+    post(machine, SIG_TICK, "TICK");
+    post(machine, SIG_TICK, "TICK");
+    post(machine, SIG_SWITCH, "SWITCH");
+    post(machine, SIG_TICK, "TICK");
+}
+
+
+int main(int argc, const char* argv[]) {
+    cout << "---------------------------------------------- without cache" << endl;
+    Machine plain;
+    plain.init(TEST_STATE(&Machine::stateLEFT));
+    run(&plain);
+
+    cout << "---------------------------------------------- with cache" << endl;
+    Machine cached;
+    TEST_BUBBLE bubbles[2];
+    cached.setBubbleCache(bubbles, 2);
+    cached.init(TEST_STATE(&Machine::stateLEFT));
+    run(&cached);
+}
+
+
+#endif
@@ -0,0 +1,3 @@
+// The bubble test, with the machine derived from HSMStatic.
+#define TEST_STATIC
+#include "../bubble/main.cpp"
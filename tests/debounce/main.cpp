@@ -0,0 +1,88 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum Signals {
+    SIG_BUTTON_DOWN = SIG_USER,
+    SIG_BUTTON_UP,
+    SIG_DOOR_OPEN,
+    SIG_DOOR_CLOSED,
+    SIG_LIMIT,
+};
+
+
+const char* signalName(uint8_t sig) {
+    if (sig == SIG_BUTTON_DOWN) { return "BUTTON_DOWN"; }
+    if (sig == SIG_BUTTON_UP)   { return "BUTTON_UP"; }
+    if (sig == SIG_DOOR_OPEN)   { return "DOOR_OPEN"; }
+    if (sig == SIG_DOOR_CLOSED) { return "DOOR_CLOSED"; }
+    if (sig == SIG_LIMIT)       { return "LIMIT"; }
+    return "???";
+}
+
+
+QueueRingBuffer<Event, 8> buttons;
+QueueRingBuffer<Event, 8> door;
+
+
+void printQueue(const char* name, IQueue* queue) {
+    while (queue->size()) {
+        cout << " " << name << ":" << signalName(queue->front()->signal);
+        queue->pop_front();
+    }
+}
+
+
+int main(int argc, const char* argv[]) {
+    const InputEdges EDGES[] = {
+        { 0,  SIG_BUTTON_DOWN, SIG_BUTTON_UP,   &buttons },
+        { 5,  SIG_DOOR_OPEN,   SIG_DOOR_CLOSED, &door },
+        { 31, SIG_LIMIT,       0,               &buttons },
+    };
+
+    cout << "---------------------------------------------- bouncing" << endl;
+    Debouncer<uint32_t> debouncer(EDGES, 3);
+    // input 0 bounces on the way down and up, input 5 changes cleanly,
+    // input 31 only glitches for three samples, and input 9 isn't listed
+    const uint32_t SAMPLES[] = {
+        0x00000001, 0x00000000, 0x00000001, 0x00000001, 0x00000001, 0x00000001,
+        0x00000021, 0x80000021, 0x80000021, 0x80000021, 0x00000221, 0x00000220,
+        0x00000221, 0x00000220, 0x00000220, 0x00000220, 0x00000220, 0x00000020,
+        0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    };
+    for (uint8_t s = 0; s < sizeof(SAMPLES) / sizeof(SAMPLES[0]); s++) {
+        uint32_t changed = debouncer.sample(SAMPLES[s]);
+        cout << "sample " << int(s) << " state " << hex << debouncer.state() << dec;
+        if (changed) {
+            cout << " changed " << hex << changed << dec;
+        }
+        printQueue("buttons", &buttons);
+        printQueue("door", &door);
+        cout << endl;
+    }
+
+    cout << "---------------------------------------------- 64 inputs" << endl;
+    const InputEdges HIGH_EDGES[] = {
+        { 63, SIG_LIMIT, SIG_BUTTON_UP, &buttons },
+    };
+    // the inputs start on, so it's the falling edge which is posted
+    Debouncer<uint64_t> wide(HIGH_EDGES, 1, ~uint64_t(0));
+    for (uint8_t s = 0; s < 4; s++) {
+        wide.sample(0);
+    }
+    cout << "state " << hex << wide.state() << dec;
+    printQueue("buttons", &buttons);
+    cout << endl;
+}
+
+
+#endif
@@ -0,0 +1,132 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+#include <thread>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define THREADED_EVENTS 100000
+
+
+struct Sample : Event {
+    uint32_t    value;
+};
+
+
+class Printer : public FSM {
+    public:
+        IQueue* queue;
+
+        DispatchOutcome statePRINTING(const Event* event) {
+            if (SIG_USER == event->signal) {
+                uint32_t value = static_cast<const Sample*>(event)->value;
+                cout << value << " ";
+                if (value == 2) {
+                    // posted while the batch is being drained, so it's in the next one
+                    Sample sample;
+                    sample.signal = SIG_USER;
+                    sample.value = 20;
+                    queue->push_back(&sample, sizeof(sample));
+                }
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+class Checker : public FSM {
+    public:
+        uint32_t expected;
+        uint32_t wrong;
+
+        DispatchOutcome stateCHECKING(const Event* event) {
+            if (SIG_USER == event->signal) {
+                if (static_cast<const Sample*>(event)->value != expected) {
+                    wrong++;
+                }
+                expected++;
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+int main(int argc, const char* argv[]) {
+    Sample sample;
+    sample.signal = SIG_USER;
+
+    cout << "---------------------------------------------- batches" << endl;
+    QueueDoubleBuffer<Sample, 4> queue;
+    Printer printer;
+    printer.queue = &queue;
+    printer.init((State) &Printer::statePRINTING);
+    cout << "empty size " << int(queue.size()) << (queue.front() ? " has front" : " no front") << endl;
+    for (sample.value = 1; sample.value <= 3; sample.value++) {
+        queue.push(sample);
+    }
+    cout << "size " << int(queue.size()) << endl;
+    sample.value = 10;
+    queue.push(sample);
+    cout << "size while draining " << int(queue.size()) << endl;
+    dispatchAll(&printer, &queue, false);
+    cout << endl << "size " << int(queue.size()) << endl;
+
+    cout << "---------------------------------------------- full" << endl;
+    for (sample.value = 1; sample.value <= 5; sample.value++) {
+        cout << (queue.push(sample) ? "pushed " : "full ");
+    }
+    cout << endl;
+    // one more batch fits in the other buffer once this one is being drained
+    cout << "size " << int(queue.size()) << endl;
+    cout << (queue.push(sample) ? "pushed" : "full") << endl;
+    dispatchAll(&printer, &queue, false);
+    cout << endl;
+
+    cout << "---------------------------------------------- plain events" << endl;
+    // only the Event part of a plain event is read, and the rest is zeroed
+    Event plain;
+    plain.signal = SIG_USER;
+    queue.push_back(&plain);
+    sample.value = 30;
+    cout << "sized " << queue.push_back(&sample, sizeof(sample)) << endl;
+    dispatchAll(&printer, &queue, false);
+    cout << endl;
+
+    cout << "---------------------------------------------- threads" << endl;
+    QueueDoubleBufferMutex<Sample, 64> shared;
+    Checker checker;
+    checker.expected = 0;
+    checker.wrong = 0;
+    checker.init((State) &Checker::stateCHECKING);
+    thread producer([&shared]() {
+        Sample sample;
+        sample.signal = SIG_USER;
+        for (sample.value = 0; sample.value < THREADED_EVENTS; sample.value++) {
+            while (! shared.push(sample)) {
+                this_thread::yield();
+            }
+        }
+    });
+    while (checker.expected < THREADED_EVENTS) {
+        if (shared.size()) {
+            dispatchAll(&checker, &shared, false);
+        }
+        else {
+            this_thread::yield();
+        }
+    }
+    producer.join();
+    cout << "received " << checker.expected << ", out of order " << checker.wrong << endl;
+}
+
+
+#endif
@@ -0,0 +1,127 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define MACHINES 64
+#define WORKERS 4
+#define POSTERS 4
+#define EVENTS_PER_POSTER 1000
+#define RELAYS 10000
+
+enum Signals {
+    SIG_COUNT = SIG_USER,
+    SIG_RELAY,
+};
+
+
+atomic<uint32_t> overlaps(0);
+atomic<uint32_t> relays(0);
+Executor executor(WORKERS, 16, 4);   // small deques and batches, to exercise overflow
+ExecutorMachine* machines[MACHINES];
+
+
+class Counter : public FSM {
+    public:
+        uint32_t count;
+        uint32_t index;
+        atomic<bool> busy;
+
+        Counter() : count(0), index(0), busy(false) {}
+
+        DispatchOutcome stateCOUNTING(const Event* event) {
+            if (busy.exchange(true)) {
+                overlaps++;
+            }
+            if (SIG_COUNT == event->signal) {
+                count++;
+            }
+            if (SIG_RELAY == event->signal) {
+                // pass the relay on to the next machine (from inside a worker)
+                // (there's only one relay, so the other workers keep
+                // draining the queues while this one waits)
+                if (relays++ < RELAYS - 1) {
+                    Event relay;
+                    relay.signal = SIG_RELAY;
+                    while (! executor.post(machines[(index + 1) % MACHINES], &relay)) {
+                        this_thread::yield();
+                    }
+                }
+            }
+            busy = false;
+            return TW_HANDLED();
+        }
+};
+
+
+Counter counters[MACHINES];
+QueueRingBuffer<Event, 8> queues[MACHINES];
+
+
+void poster() {
+    Event event;
+    event.signal = SIG_COUNT;
+    for (uint32_t e = 0; e < EVENTS_PER_POSTER; e++) {
+        for (uint32_t m = 0; m < MACHINES; m++) {
+            while (! executor.post(machines[m], &event)) {
+                // queue is full, wait for the workers to catch up
+                this_thread::yield();
+            }
+        }
+    }
+}
+
+
+int main(int argc, const char* argv[]) {
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        counters[m].index = m;
+        counters[m].init((State) &Counter::stateCOUNTING);
+        machines[m] = new ExecutorMachine(&counters[m], &queues[m]);
+    }
+    executor.start();
+
+    Event relay;
+    relay.signal = SIG_RELAY;
+    executor.post(machines[0], &relay);
+
+    vector<thread> posters;
+    for (uint32_t p = 0; p < POSTERS; p++) {
+        posters.push_back(thread(poster));
+    }
+    for (uint32_t p = 0; p < POSTERS; p++) {
+        posters[p].join();
+    }
+    executor.waitIdle();
+
+    uint32_t total = 0;
+    bool even = true;
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        total += counters[m].count;
+        even = even && (counters[m].count == POSTERS * EVENTS_PER_POSTER);
+    }
+    cout << "counted " << total << " (each machine " << (even ? "got all its events" : "MISSED EVENTS") << ")" << endl;
+    cout << "relayed " << relays.load() << endl;
+    cout << "overlapping dispatches " << overlaps.load() << endl;
+
+    executor.stop();
+    cout << "stopped" << endl;
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        delete machines[m];
+    }
+}
+
+
+#endif
@@ -0,0 +1,106 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum Signals {
+    SIG_START = SIG_USER,
+    SIG_STOP,
+    SIG_DATA,
+    SIG_NOISE,
+};
+
+
+const char* signalName(uint8_t sig) {
+    if (sig == SIG_ENTER) { return "ENTER"; }
+    if (sig == SIG_LEAVE) { return "LEAVE"; }
+    if (sig == SIG_INIT)  { return "INIT"; }
+    if (sig == SIG_START) { return "START"; }
+    if (sig == SIG_STOP)  { return "STOP"; }
+    if (sig == SIG_DATA)  { return "DATA"; }
+    if (sig == SIG_NOISE) { return "NOISE"; }
+    return "???";
+}
+
+
+class Recorder : public FSM {
+    public:
+        DispatchOutcome stateIDLE(const Event* event) {
+            cout << "idle-" << signalName(event->signal) << ";";
+            switch (event->signal) {
+                case SIG_START:
+                    return TW_TRANSITION(&Recorder::stateRECORDING);
+            }
+            return TW_HANDLED();
+        }
+
+        DispatchOutcome stateRECORDING(const Event* event) {
+            cout << "recording-" << signalName(event->signal) << ";";
+            switch (event->signal) {
+                case SIG_STOP:
+                    return TW_TRANSITION(&Recorder::stateIDLE);
+                case SIG_DATA:
+                    return TW_HANDLED();
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+const StateSignals SIGNALS[] = {
+    { (State) &Recorder::stateIDLE,      TW_SIGNAL(SIG_START) },
+    { (State) &Recorder::stateRECORDING, TW_SIGNAL(SIG_STOP) | TW_SIGNAL(SIG_DATA) },
+};
+
+
+void post(QueueFilter* queue, uint8_t signal) {
+    Event event;
+    event.signal = signal;
+    queue->push_back(&event);
+}
+
+
+int main(int argc, const char* argv[]) {
+    Recorder recorder;
+    QueueRingBuffer<Event, 8> ring;
+    QueueFilter queue(&ring, &recorder, SIGNALS, 2);
+    cout << "init: ";
+    recorder.init((State) &Recorder::stateIDLE);
+    cout << endl;
+
+    cout << "---------------------------------------------- flood while idle" << endl;
+    for (uint8_t i = 0; i < 100; i++) {
+        post(&queue, SIG_DATA);
+        post(&queue, SIG_NOISE);
+    }
+    cout << "queued " << int(ring.size()) << ", filtered " << queue.filtered() << endl;
+
+    cout << "---------------------------------------------- behind a START" << endl;
+    // these DATA are accepted by the state START leads to, so they're kept
+    post(&queue, SIG_START);
+    post(&queue, SIG_DATA);
+    post(&queue, SIG_NOISE);
+    post(&queue, SIG_DATA);
+    cout << "queued " << int(ring.size()) << endl;
+    dispatchAll(&recorder, &queue, false);
+    cout << endl << "filtered " << queue.filtered() << endl;
+
+    cout << "---------------------------------------------- behind a STOP" << endl;
+    post(&queue, SIG_STOP);
+    post(&queue, SIG_DATA);
+    post(&queue, SIG_START);
+    post(&queue, SIG_DATA);
+    dispatchAll(&recorder, &queue, false);
+    cout << endl << "filtered " << queue.filtered() << endl;
+}
+
+
+#endif
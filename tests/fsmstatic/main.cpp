@@ -0,0 +1,3 @@
+// The fsmtest test, with the machine derived from FSMStatic.
+#define TEST_STATIC
+#include "../fsmtest/main.cpp"
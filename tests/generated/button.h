@@ -0,0 +1,155 @@
+// Generated by tools/twgen.py from button.tw, do not edit.
+
+#ifndef TW_GEN_BUTTON_H
+#define TW_GEN_BUTTON_H
+
+#include "../../src/TrimWright.h"
+
+namespace ButtonTables {
+
+    enum : uint8_t {
+        SIG_TIMER = TrimWright::SIG_USER,
+        SIG_BUTTON_DOWN,
+        SIG_BUTTON_UP,
+        SIG_RESET,
+    };
+
+    enum : uint8_t {
+        STATE_UP,
+        STATE_DOWN,
+        STATE_HOLDING,
+        STATE_REPEATING,
+        STATE_COUNT
+    };
+
+    const uint8_t NONE = 0xFF;
+    const uint8_t SIGNAL_COUNT = 4;
+
+    // signals are numbered consecutively, so SIG_X is column (SIG_X - SIGNAL_FIRST) of ROWS
+    const uint8_t SIGNAL_FIRST = SIG_TIMER;
+
+    constexpr uint8_t PARENT[STATE_COUNT] = {
+        NONE,                    // up
+        NONE,                    // down
+        STATE_DOWN,              // holding
+        STATE_DOWN,              // repeating
+    };
+
+    struct Candidate {
+        uint8_t     guard;  // 0 if none
+        uint16_t    begin;  // actions to run are OPS[begin] to OPS[end-1]
+        uint16_t    end;
+        uint8_t     next;   // next current state, NONE for internal transitions
+        uint8_t     more;   // candidate to try if the guard fails
+    };
+
+    constexpr Candidate CANDIDATES[] = {
+        { 0, 0, 2, STATE_HOLDING, NONE },
+        { 0, 2, 4, STATE_UP, NONE },
+        { 0, 4, 8, STATE_HOLDING, NONE },
+        { 0, 8, 10, STATE_REPEATING, NONE },
+        { 0, 10, 13, STATE_UP, NONE },
+        { 0, 13, 17, STATE_HOLDING, NONE },
+        { 1, 17, 18, NONE, 7 },
+        { 0, 18, 21, STATE_UP, NONE },
+        { 0, 21, 23, STATE_UP, NONE },
+        { 0, 23, 27, STATE_HOLDING, NONE },
+    };
+
+    // first candidate for each state (row) and signal (column)
+    constexpr uint8_t ROWS[STATE_COUNT][SIGNAL_COUNT] = {
+        { NONE, 0, NONE, NONE }, // up
+        { NONE, NONE, 1, 2 }, // down
+        { 3, NONE, 4, 5 }, // holding
+        { 6, NONE, 8, 9 }, // repeating
+    };
+
+    // action ids, see ButtonMachine::act()
+    constexpr uint8_t OPS[] = {
+        2, 4, 3, 1, 3, 6, 2, 4, 7, 5, 3, 8, 1, 3, 6, 2, 4, 7, 3, 9, 1, 3, 1, 3, 6, 2, 4, 1
+    };
+
+};
+
+
+// The sketch derives its class from this one (which is templated on that
+// class) and implements the actions and guards as methods, for example:
+//     class Button : public ButtonMachine<Button> { ... };
+// Call start() (instead of init()) to enter the initial state.
+template <class Derived>
+class ButtonMachine : public TrimWright::FSM {
+    protected:
+        uint8_t m_state;
+
+        void act(uint8_t action, const TrimWright::Event* event) {
+            Derived* self = static_cast<Derived*>(this);
+            switch (action) {
+                case 1: self->enter_up(event); break;
+                case 2: self->enter_down(event); break;
+                case 3: self->exit_down(event); break;
+                case 4: self->enter_holding(event); break;
+                case 5: self->enter_repeating(event); break;
+                case 6: self->reset(event); break;
+                case 7: self->hold(event); break;
+                case 8: self->click(event); break;
+                case 9: self->tooLong(event); break;
+            }
+        }
+
+        bool guard(uint8_t guard, const TrimWright::Event* event) {
+            Derived* self = static_cast<Derived*>(this);
+            switch (guard) {
+                case 1: return self->canRepeat(event);
+            }
+            return true;
+        }
+
+    public:
+        ButtonMachine() : m_state(ButtonTables::NONE) {}
+
+        void start() {
+            for (uint16_t op = 27; op < 28; op++) {
+                act(ButtonTables::OPS[op], &(PSEUDOEVENTS[TrimWright::SIG_ENTER]));
+            }
+            m_state = ButtonTables::STATE_UP;
+        }
+
+        // the current (innermost) state
+        uint8_t state() const {
+            return m_state;
+        }
+
+        // whether the state (or one of its substates) is current
+        bool isIn(uint8_t state) const {
+            for (uint8_t s = m_state; s != ButtonTables::NONE; s = ButtonTables::PARENT[s]) {
+                if (s == state) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        virtual void dispatch(const TrimWright::Event* event) {
+            uint8_t column = uint8_t(event->signal - ButtonTables::SIGNAL_FIRST);
+            if (column >= ButtonTables::SIGNAL_COUNT || m_state == ButtonTables::NONE) {
+                return;
+            }
+            uint8_t c = ButtonTables::ROWS[m_state][column];
+            for (; c != ButtonTables::NONE; c = ButtonTables::CANDIDATES[c].more) {
+                const ButtonTables::Candidate& candidate = ButtonTables::CANDIDATES[c];
+                if (candidate.guard && !guard(candidate.guard, event)) {
+                    continue;
+                }
+                for (uint16_t op = candidate.begin; op < candidate.end; op++) {
+                    act(ButtonTables::OPS[op], event);
+                }
+                if (candidate.next != ButtonTables::NONE) {
+                    m_state = candidate.next;
+                }
+                return;
+            }
+        }
+};
+
+
+#endif
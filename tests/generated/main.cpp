@@ -0,0 +1,112 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "button.h"
+using namespace ButtonTables;
+
+
+const char* signalName(uint8_t sig) {
+    if (sig == TrimWright::SIG_ENTER) { return "ENTER"; }
+    if (sig == SIG_TIMER)       { return "TIMER"; }
+    if (sig == SIG_BUTTON_DOWN) { return "DOWN"; }
+    if (sig == SIG_BUTTON_UP)   { return "UP"; }
+    if (sig == SIG_RESET)       { return "RESET"; }
+    return "???";
+}
+
+
+const char* stateName(uint8_t state) {
+    if (state == STATE_UP)          { return "up"; }
+    if (state == STATE_DOWN)        { return "down"; }
+    if (state == STATE_HOLDING)     { return "holding"; }
+    if (state == STATE_REPEATING)   { return "repeating"; }
+    return "???";
+}
+
+
+class Button : public ButtonMachine<Button> {
+    public:
+        uint8_t repeats;
+
+        void post(uint8_t signal) {
+            TrimWright::Event event;
+            event.signal = signal;
+            cout << signalName(signal) << ": ";
+            dispatch(&event);
+            cout << "=> " << stateName(state()) << (isIn(STATE_DOWN) ? " (in down)" : "") << endl;
+        }
+
+        void enter_up(const TrimWright::Event* event) {
+            cout << "enter_up;";
+        }
+        void enter_down(const TrimWright::Event* event) {
+            cout << "enter_down;";
+        }
+        void exit_down(const TrimWright::Event* event) {
+            cout << "exit_down;";
+        }
+        void enter_holding(const TrimWright::Event* event) {
+            cout << "enter_holding;";
+        }
+        void enter_repeating(const TrimWright::Event* event) {
+            cout << "enter_repeating;";
+            repeats = 0;
+        }
+        void reset(const TrimWright::Event* event) {
+            cout << "reset;";
+        }
+        void hold(const TrimWright::Event* event) {
+            cout << "hold;";
+        }
+        void click(const TrimWright::Event* event) {
+            cout << "click;";
+        }
+        void tooLong(const TrimWright::Event* event) {
+            cout << "tooLong;";
+        }
+        bool canRepeat(const TrimWright::Event* event) {
+            cout << "canRepeat?;";
+            return ++repeats < 3;
+        }
+};
+
+
+int main(int argc, const char* argv[]) {
+    Button button;
+    cout << "start: ";
+    button.start();
+    cout << "=> " << stateName(button.state()) << endl;
+
+    cout << "---------------------------------------------- click" << endl;
+    button.post(SIG_BUTTON_UP);
+    button.post(SIG_BUTTON_DOWN);
+    button.post(SIG_BUTTON_UP);
+
+    cout << "---------------------------------------------- hold" << endl;
+    button.post(SIG_BUTTON_DOWN);
+    button.post(SIG_TIMER);
+    button.post(SIG_TIMER);
+    button.post(SIG_RESET);
+    button.post(SIG_TIMER);
+    button.post(SIG_TIMER);
+    button.post(SIG_TIMER);
+    button.post(SIG_TIMER);
+
+    cout << "---------------------------------------------- queue" << endl;
+    TrimWright::QueueRingBuffer<TrimWright::Event, 4> queue;
+    TrimWright::Event event;
+    event.signal = SIG_BUTTON_DOWN, queue.push_back(&event);
+    event.signal = SIG_BUTTON_UP, queue.push_back(&event);
+    TrimWright::dispatchAll(&button, &queue, true);
+    cout << "=> " << stateName(button.state()) << endl;
+}
+
+
+#endif
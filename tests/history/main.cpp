@@ -0,0 +1,187 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#define TRIMWRIGHT_HISTORY 1
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum {
+    SIG_NEXT = SIG_USER,
+    SIG_OFF,
+    SIG_SHALLOW,
+    SIG_DEEP
+};
+
+
+const char* signalName(uint8_t sig) {
+    if (sig == SIG_SUPER)   { return "SUPER"; }
+    if (sig == SIG_ENTER)   { return "ENTER"; }
+    if (sig == SIG_LEAVE)   { return "LEAVE"; }
+    if (sig == SIG_INIT)    { return "INIT"; }
+    if (sig == SIG_IDLE)    { return "IDLE"; }
+    if (sig == SIG_NEXT)    { return "NEXT"; }
+    if (sig == SIG_OFF)     { return "OFF"; }
+    if (sig == SIG_SHALLOW) { return "SHALLOW"; }
+    if (sig == SIG_DEEP)    { return "DEEP"; }
+    return "???";
+}
+
+
+// tests/historystatic defines TEST_STATIC and includes this file, so the
+// same machine runs over both bases.
+#ifdef TEST_STATIC
+#define TEST_BASE HSMStatic<Machine>
+#define TEST_HISTORY HistoryStatic<Machine>
+#define TEST_STATE(s) (s)
+#else
+#define TEST_BASE HSM
+#define TEST_HISTORY History
+#define TEST_STATE(s) ((State) (s))
+#endif
+
+
+//  on (shallow and deep history)
+//      a
+//          a1
+//          a2
+//      b
+//  off
+class Machine : public TEST_BASE {
+    public:
+        TEST_HISTORY histories[2];
+
+        Machine() {
+            histories[0].composite = TEST_STATE(&Machine::stateON);
+            histories[0].last = 0;
+            histories[0].deep = false;
+            histories[1].composite = TEST_STATE(&Machine::stateON);
+            histories[1].last = 0;
+            histories[1].deep = true;
+            setHistories(histories, 2);
+        }
+
+        void post(uint8_t signal) {
+            Event event;
+            event.signal = signal;
+            cout << signalName(signal) << ": ";
+            dispatch(&event);
+            cout << endl;
+        }
+
+        void debugDispatch(const Event* event, const char* stateName) {
+            if (SIG_SUPER == event->signal) {
+                return;
+            }
+            cout << stateName << "-" << signalName(event->signal) << ";";
+        }
+
+        DispatchOutcome stateON(const Event* event) {
+            debugDispatch(event, "on");
+            switch (event->signal) {
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateA);
+                case SIG_OFF:
+                    return TW_TRANSITION(&Machine::stateOFF);
+            }
+            return TW_SUPER(&Machine::stateROOT);
+        }
+
+        DispatchOutcome stateA(const Event* event) {
+            debugDispatch(event, "a");
+            switch (event->signal) {
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateA1);
+            }
+            return TW_SUPER(&Machine::stateON);
+        }
+
+        DispatchOutcome stateA1(const Event* event) {
+            debugDispatch(event, "a1");
+            switch (event->signal) {
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+                case SIG_NEXT:
+                    return TW_TRANSITION(&Machine::stateA2);
+            }
+            return TW_SUPER(&Machine::stateA);
+        }
+
+        DispatchOutcome stateA2(const Event* event) {
+            debugDispatch(event, "a2");
+            switch (event->signal) {
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+                case SIG_NEXT:
+                    return TW_TRANSITION(&Machine::stateB);
+            }
+            return TW_SUPER(&Machine::stateA);
+        }
+
+        DispatchOutcome stateB(const Event* event) {
+            debugDispatch(event, "b");
+            switch (event->signal) {
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+                case SIG_NEXT:
+                    return TW_TRANSITION(&Machine::stateA2);
+            }
+            return TW_SUPER(&Machine::stateON);
+        }
+
+        DispatchOutcome stateOFF(const Event* event) {
+            debugDispatch(event, "off");
+            switch (event->signal) {
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+                case SIG_SHALLOW:
+                    return TW_HISTORY(histories[0]);
+                case SIG_DEEP:
+                    return TW_HISTORY(histories[1]);
+            }
+            return TW_SUPER(&Machine::stateROOT);
+        }
+};
+
+
+int main(int argc, const char* argv[]) {
+    Machine machine;
+    cout << "init: ";
+    machine.init(TEST_STATE(&Machine::stateOFF));
+    cout << endl;
+
+    cout << "---------------------------------------------- never left" << endl;
+    machine.post(SIG_DEEP);
+    machine.post(SIG_NEXT);
+
+    cout << "---------------------------------------------- deep" << endl;
+    machine.post(SIG_OFF);
+    machine.post(SIG_DEEP);
+
+    cout << "---------------------------------------------- shallow" << endl;
+    machine.post(SIG_OFF);
+    machine.post(SIG_SHALLOW);
+    machine.post(SIG_NEXT);
+    machine.post(SIG_NEXT);
+    machine.post(SIG_OFF);
+    machine.post(SIG_SHALLOW);
+}
+
+
+#endif
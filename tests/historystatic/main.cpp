@@ -0,0 +1,3 @@
+// The history test, with the machine derived from HSMStatic.
+#define TEST_STATIC
+#include "../history/main.cpp"
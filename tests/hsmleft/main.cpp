@@ -0,0 +1,171 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum {
+    SIG_TO_A = SIG_USER,
+    SIG_TO_B,
+    SIG_TO_SELF,
+};
+
+
+const char* signalName(uint8_t sig) {
+    if (sig == SIG_SUPER) { return "SUPER"; }
+    if (sig == SIG_ENTER) { return "ENTER"; }
+    if (sig == SIG_LEAVE) { return "LEAVE"; }
+    if (sig == SIG_INIT)  { return "INIT"; }
+    if (sig == SIG_TO_A)  { return "TO_A"; }
+    if (sig == SIG_TO_B)  { return "TO_B"; }
+    if (sig == SIG_TO_SELF) { return "TO_SELF"; }
+    return "???";
+}
+
+
+uint32_t calls = 0;
+void trace(const Event* event, const char* stateName) {
+    calls++;
+    cout << stateName << "-" << signalName(event->signal) << ";";
+}
+
+
+// What the states return for SIG_LEAVE.
+enum Leave {
+    LEAVE_HANDLED,      // TW_HANDLED(), so the HSM asks for the parent
+    LEAVE_LEFT,         // TW_LEFT(parent)
+    LEAVE_UNHANDLED,    // TW_UNHANDLED(), which also makes the HSM ask
+};
+
+
+// The same machine, leaving its states each way.
+//  a (INIT) > a1 > a11
+//  b (INIT) > b1 > b11
+// SIG_TO_A and SIG_TO_B are handled at the top, SIG_TO_SELF by the leaves.
+template <Leave LEAVE>
+class Machine : public HSM {
+    public:
+        void post(uint8_t signal) {
+            Event event;
+            event.signal = signal;
+            cout << signalName(signal) << ": ";
+            calls = 0;
+            dispatch(&event);
+            cout << " (" << calls << " calls)" << endl;
+        }
+
+        void start() {
+            cout << "init: ";
+            calls = 0;
+            TW_METHOD_INIT((State) &Machine::stateA);
+            cout << " (" << calls << " calls)" << endl;
+        }
+
+        DispatchOutcome left(State parent) {
+            switch (LEAVE) {
+                case LEAVE_HANDLED:
+                    return TW_HANDLED();
+                case LEAVE_LEFT:
+                    return TW_LEFT(parent);
+                default:
+                    return TW_UNHANDLED();
+            }
+        }
+
+        DispatchOutcome stateA(const Event* event) {
+            trace(event, "a");
+            switch (event->signal) {
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateA11);
+                case SIG_LEAVE:
+                    return left((State) &Machine::stateROOT);
+                case SIG_TO_B:
+                    return TW_TRANSITION(&Machine::stateB);
+            }
+            return TW_SUPER(&Machine::stateROOT);
+        }
+
+        DispatchOutcome stateA1(const Event* event) {
+            trace(event, "a1");
+            switch (event->signal) {
+                case SIG_LEAVE:
+                    return left((State) &Machine::stateA);
+            }
+            return TW_SUPER(&Machine::stateA);
+        }
+
+        DispatchOutcome stateA11(const Event* event) {
+            trace(event, "a11");
+            switch (event->signal) {
+                case SIG_LEAVE:
+                    return left((State) &Machine::stateA1);
+                case SIG_TO_SELF:
+                    return TW_TRANSITION(&Machine::stateA11);
+            }
+            return TW_SUPER(&Machine::stateA1);
+        }
+
+        DispatchOutcome stateB(const Event* event) {
+            trace(event, "b");
+            switch (event->signal) {
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateB11);
+                case SIG_LEAVE:
+                    return left((State) &Machine::stateROOT);
+                case SIG_TO_A:
+                    return TW_TRANSITION(&Machine::stateA);
+            }
+            return TW_SUPER(&Machine::stateROOT);
+        }
+
+        DispatchOutcome stateB1(const Event* event) {
+            trace(event, "b1");
+            switch (event->signal) {
+                case SIG_LEAVE:
+                    return left((State) &Machine::stateB);
+            }
+            return TW_SUPER(&Machine::stateB);
+        }
+
+        DispatchOutcome stateB11(const Event* event) {
+            trace(event, "b11");
+            switch (event->signal) {
+                case SIG_LEAVE:
+                    return left((State) &Machine::stateB1);
+                case SIG_TO_SELF:
+                    return TW_TRANSITION(&Machine::stateB11);
+            }
+            return TW_SUPER(&Machine::stateB1);
+        }
+};
+
+
+template <Leave LEAVE>
+void run() {
+    Machine<LEAVE> machine;
+    machine.start();
+    machine.post(SIG_TO_B);
+    machine.post(SIG_TO_SELF);
+    machine.post(SIG_TO_A);
+    machine.post(SIG_TO_SELF);
+    cout << "in a11 " << (machine.currentState() == (State) &Machine<LEAVE>::stateA11 ? "yes" : "no") << endl;
+}
+
+
+int main(int argc, const char* argv[]) {
+    cout << "---------------------------------------------- TW_HANDLED" << endl;
+    run<LEAVE_HANDLED>();
+    cout << "---------------------------------------------- TW_LEFT" << endl;
+    run<LEAVE_LEFT>();
+    cout << "---------------------------------------------- TW_UNHANDLED" << endl;
+    run<LEAVE_UNHANDLED>();
+}
+
+
+#endif
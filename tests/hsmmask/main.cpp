@@ -0,0 +1,153 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum {
+    SIG_TO_A = SIG_USER,
+    SIG_TO_B,
+    SIG_TO_SELF,
+};
+
+
+const char* signalName(uint8_t sig) {
+    if (sig == SIG_SUPER) { return "SUPER"; }
+    if (sig == SIG_ENTER) { return "ENTER"; }
+    if (sig == SIG_LEAVE) { return "LEAVE"; }
+    if (sig == SIG_INIT)  { return "INIT"; }
+    if (sig == SIG_TO_A)  { return "TO_A"; }
+    if (sig == SIG_TO_B)  { return "TO_B"; }
+    if (sig == SIG_TO_SELF) { return "TO_SELF"; }
+    return "???";
+}
+
+
+uint32_t calls = 0;
+void trace(const Event* event, const char* stateName) {
+    calls++;
+    cout << stateName << "-" << signalName(event->signal) << ";";
+}
+
+
+// The same machine, with and without TW_SUPER_MASK().
+//  a (INIT) > a1 > a11 (ENTER)
+//  b (INIT) > b1 > b11 (ENTER)
+// SIG_TO_A and SIG_TO_B are handled at the top, SIG_TO_SELF by the leaves.
+template <bool MASKED>
+class Machine : public HSM {
+    public:
+        void post(uint8_t signal) {
+            Event event;
+            event.signal = signal;
+            cout << signalName(signal) << ": ";
+            calls = 0;
+            dispatch(&event);
+            cout << " (" << calls << " calls)" << endl;
+        }
+
+        void start() {
+            cout << "init: ";
+            calls = 0;
+            TW_METHOD_INIT((State) &Machine::stateA);
+            cout << " (" << calls << " calls)" << endl;
+        }
+
+        DispatchOutcome stateA(const Event* event) {
+            trace(event, "a");
+            switch (event->signal) {
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateA11);
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateROOT);
+                case SIG_TO_B:
+                    return TW_TRANSITION(&Machine::stateB);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateROOT, TW_ON_INIT) : TW_SUPER(&Machine::stateROOT);
+        }
+
+        DispatchOutcome stateA1(const Event* event) {
+            trace(event, "a1");
+            switch (event->signal) {
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateA);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateA, TW_ON_NONE) : TW_SUPER(&Machine::stateA);
+        }
+
+        DispatchOutcome stateA11(const Event* event) {
+            trace(event, "a11");
+            switch (event->signal) {
+                case SIG_ENTER:
+                    return TW_HANDLED();
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateA1);
+                case SIG_TO_SELF:
+                    return TW_TRANSITION(&Machine::stateA11);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateA1, TW_ON_ENTER) : TW_SUPER(&Machine::stateA1);
+        }
+
+        DispatchOutcome stateB(const Event* event) {
+            trace(event, "b");
+            switch (event->signal) {
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateB11);
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateROOT);
+                case SIG_TO_A:
+                    return TW_TRANSITION(&Machine::stateA);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateROOT, TW_ON_INIT) : TW_SUPER(&Machine::stateROOT);
+        }
+
+        DispatchOutcome stateB1(const Event* event) {
+            trace(event, "b1");
+            switch (event->signal) {
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateB);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateB, TW_ON_NONE) : TW_SUPER(&Machine::stateB);
+        }
+
+        DispatchOutcome stateB11(const Event* event) {
+            trace(event, "b11");
+            switch (event->signal) {
+                case SIG_ENTER:
+                    return TW_HANDLED();
+                case SIG_LEAVE:
+                    return TW_LEFT(&Machine::stateB1);
+                case SIG_TO_SELF:
+                    return TW_TRANSITION(&Machine::stateB11);
+            }
+            return MASKED ? TW_SUPER_MASK(&Machine::stateB1, TW_ON_ENTER) : TW_SUPER(&Machine::stateB1);
+        }
+};
+
+
+template <bool MASKED>
+void run() {
+    Machine<MASKED> machine;
+    machine.start();
+    machine.post(SIG_TO_B);
+    machine.post(SIG_TO_SELF);
+    machine.post(SIG_TO_A);
+    machine.post(SIG_TO_SELF);
+}
+
+
+int main(int argc, const char* argv[]) {
+    cout << "---------------------------------------------- TW_SUPER" << endl;
+    run<false>();
+    cout << "---------------------------------------------- TW_SUPER_MASK" << endl;
+    run<true>();
+}
+
+
+#endif
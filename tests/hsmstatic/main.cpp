@@ -0,0 +1,3 @@
+// The hsmtest test, with the machine derived from HSMStatic.
+#define TEST_STATIC
+#include "../hsmtest/main.cpp"
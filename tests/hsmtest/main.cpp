@@ -47,7 +47,18 @@ void debugDispatch(const TrimWright::Event* event, const char* stateName) {
 }
 
 
-class Test : public TrimWright::HSM {
+// tests/hsmstatic defines TEST_STATIC and includes this file, so the same
+// machine runs over both bases.
+#ifdef TEST_STATIC
+#define TEST_BASE TrimWright::HSMStatic<Test>
+#define TEST_STATE(s) (s)
+#else
+#define TEST_BASE TrimWright::HSM
+#define TEST_STATE(s) ((TrimWright::State) (s))
+#endif
+
+
+class Test : public TEST_BASE {
     public:
         uint8_t foo;
 
@@ -244,7 +255,7 @@ class Test : public TrimWright::HSM {
 
 int main(int argc, const char* argv[]) {
     cout << "INIT:  ";
-    test.init((TrimWright::State) &Test::stateS2);
+    test.init(TEST_STATE(&Test::stateS2));
     cout << "   foo=" << int(test.foo) << endl;
 
     const char* EVENTS = "GIAD DCEE GII";
@@ -0,0 +1,148 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <time.h>
+#include <iostream>
+#include <thread>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+enum {
+    SIG_TICK = SIG_USER,
+    SIG_TIMEOUT,
+    SIG_POSTED
+};
+
+
+// the producer thread below pushes too, so the queue needs a lock
+QueueDoubleBufferMutex<Event, 4> queue;
+TimeEventList timeEvents;
+WaiterCondition waiter;
+
+
+class Machine : public FSM {
+    public:
+        TimeEvent   tick;
+        TimeEvent   timeout;
+        uint8_t     ticks;
+        uint8_t     idles;
+        Ticks       handledAt;
+
+        Machine() : tick(SIG_TICK, &queue), timeout(SIG_TIMEOUT, &queue), ticks(0), idles(0), handledAt(0) {
+            timeEvents.add(&tick);
+            timeEvents.add(&timeout);
+        }
+
+        DispatchOutcome stateTICKING(const Event* event) {
+            switch (event->signal) {
+                case SIG_ENTER:
+                    tick.arm(clockMillis(), 30, 30);
+                    return TW_HANDLED();
+                case SIG_LEAVE:
+                    tick.disarm();
+                    return TW_HANDLED();
+                case SIG_IDLE:
+                    idles++;
+                    return TW_HANDLED();
+                case SIG_TICK:
+                    cout << "tick " << int(++ticks) << endl;
+                    if (ticks == 3) {
+                        return TW_TRANSITION(&Machine::stateSLEEPING);
+                    }
+                    return TW_HANDLED();
+            }
+            return TW_HANDLED();
+        }
+
+        DispatchOutcome stateSLEEPING(const Event* event) {
+            switch (event->signal) {
+                case SIG_ENTER:
+                    timeout.arm(clockMillis(), 300);
+                    return TW_HANDLED();
+                case SIG_TIMEOUT:
+                    cout << "timeout" << endl;
+                    return TW_TRANSITION(&Machine::stateWAITING);
+            }
+            return TW_HANDLED();
+        }
+
+        DispatchOutcome stateWAITING(const Event* event) {
+            switch (event->signal) {
+                case SIG_POSTED:
+                    handledAt = clockMicros();
+                    cout << "posted" << endl;
+                    return TW_TRANSITION(&Machine::stateDONE);
+            }
+            return TW_HANDLED();
+        }
+
+        DispatchOutcome stateDONE(const Event* event) {
+            return TW_HANDLED();
+        }
+};
+
+
+double cpuMillis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+
+int main(int argc, const char* argv[]) {
+    Machine machine;
+    machine.init((State) &Machine::stateTICKING);
+
+    cout << "---------------------------------------------- time events" << endl;
+    uint32_t loops = 0;
+    while (machine.ticks < 3) {
+        dispatchAllOrWait(&machine, &queue, true, &timeEvents, clockMillis, &waiter);
+        loops++;
+    }
+    // Each tick needs at most a few passes (post, dispatch, idle and wait)
+    // so anything more means the loop is polling.
+    cout << "loops " << (loops <= 12 ? "ok" : "TOO MANY") << endl;
+    cout << "idles " << (machine.idles >= 3 ? "ok" : "TOO FEW") << endl;
+
+    cout << "---------------------------------------------- idle cpu" << endl;
+    double cpuStart = cpuMillis();
+    Ticks wallStart = clockMillis();
+    while (!machine.timeout.armed() || machine.tick.armed()) {
+        dispatchAllOrWait(&machine, &queue, false, &timeEvents, clockMillis, &waiter);
+    }
+    while (machine.timeout.armed() || queue.size()) {
+        dispatchAllOrWait(&machine, &queue, false, &timeEvents, clockMillis, &waiter);
+    }
+    Ticks wall = clockMillis() - wallStart;
+    double cpu = cpuMillis() - cpuStart;
+    cout << "waited " << (wall >= 290 ? "ok" : "TOO SHORT") << endl;
+    cout << "cpu " << (cpu < 0.1 * wall ? "ok" : "TOO BUSY") << endl;
+
+    cout << "---------------------------------------------- wakeup latency" << endl;
+    Ticks postedAt = 0;
+    thread producer([&postedAt] {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        Event e;
+        e.signal = SIG_POSTED;
+        postedAt = clockMicros();
+        queue.push(e);
+        waiter.notify();
+    });
+    while (!machine.handledAt) {
+        dispatchAllOrWait(&machine, &queue, false, &timeEvents, clockMillis, &waiter);
+    }
+    producer.join();
+    Ticks latency = machine.handledAt - postedAt;
+    cout << "latency " << (latency < 10000 ? "ok" : "TOO SLOW") << endl;
+}
+
+
+#endif
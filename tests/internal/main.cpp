@@ -0,0 +1,155 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+#include <type_traits>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum Signals {
+    SIG_START = SIG_USER,
+    SIG_STEP,
+    SIG_COMPLETE,
+    SIG_PING,
+    SIG_FLOOD,
+};
+
+
+const char* signalName(uint8_t sig) {
+    if (sig == SIG_ENTER)    { return "ENTER"; }
+    if (sig == SIG_LEAVE)    { return "LEAVE"; }
+    if (sig == SIG_INIT)     { return "INIT"; }
+    if (sig == SIG_START)    { return "START"; }
+    if (sig == SIG_STEP)     { return "STEP"; }
+    if (sig == SIG_COMPLETE) { return "COMPLETE"; }
+    if (sig == SIG_PING)     { return "PING"; }
+    if (sig == SIG_FLOOD)    { return "FLOOD"; }
+    return "???";
+}
+
+
+struct LoaderEvent : Event {
+    uint8_t     step;
+};
+
+
+// tests/internalstatic defines TEST_STATIC and includes this file, so the
+// same machine runs over both bases.
+#ifdef TEST_STATIC
+#define TEST_BASE HSMStatic<Loader>
+#define TEST_STATE(s) (s)
+#else
+#define TEST_BASE HSM
+#define TEST_STATE(s) ((State) (s))
+#endif
+
+
+class Loader : public WithInternalQueue<TEST_BASE, LoaderEvent, 4> {
+    public:
+        uint8_t steps;
+
+        Loader() : steps(3) {}
+
+        void trace(const Event* event, const char* state) {
+            if (SIG_SUPER != event->signal) {
+                cout << state << "-" << signalName(event->signal);
+                if (SIG_STEP == event->signal) {
+                    cout << int(static_cast<const LoaderEvent*>(event)->step);
+                }
+                cout << ";";
+            }
+        }
+
+        void post(uint8_t signal, uint8_t step = 0) {
+            LoaderEvent event;
+            event.signal = signal;
+            event.step = step;
+            if (! postSelf(event)) {
+                cout << "(full);";
+            }
+        }
+
+        DispatchOutcome stateIDLE(const Event* event) {
+            trace(event, "idle");
+            switch (event->signal) {
+                case SIG_ENTER:
+                    post(SIG_PING);
+                    return TW_HANDLED();
+                case SIG_START:
+                    return TW_TRANSITION(&Loader::stateLOADING);
+                case SIG_FLOOD:
+                    for (uint8_t i = 0; i < 5; i++) {
+                        post(SIG_PING);
+                    }
+                    return TW_HANDLED();
+            }
+            return TW_SUPER(&Loader::stateROOT);
+        }
+
+        DispatchOutcome stateLOADING(const Event* event) {
+            trace(event, "loading");
+            switch (event->signal) {
+                case SIG_ENTER:
+                    post(SIG_STEP, 1);
+                    return TW_HANDLED();
+                case SIG_STEP: {
+                    uint8_t step = static_cast<const LoaderEvent*>(event)->step;
+                    post(step < steps ? SIG_STEP : SIG_COMPLETE, step + 1);
+                    return TW_HANDLED();
+                }
+                case SIG_COMPLETE:
+                    return TW_TRANSITION(&Loader::stateDONE);
+            }
+            return TW_SUPER(&Loader::stateROOT);
+        }
+
+        DispatchOutcome stateDONE(const Event* event) {
+            trace(event, "done");
+            switch (event->signal) {
+                case SIG_PING:
+                    return TW_HANDLED();
+            }
+            return TW_SUPER(&Loader::stateROOT);
+        }
+};
+
+
+#ifdef TEST_STATIC
+static_assert(!std::is_polymorphic<Loader>::value, "a static machine with an internal queue has no vtable");
+#endif
+
+
+int main(int argc, const char* argv[]) {
+    Loader loader;
+    QueueRingBuffer<LoaderEvent, 4> queue;
+
+    cout << "---------------------------------------------- init" << endl;
+    loader.init(TEST_STATE(&Loader::stateIDLE));
+    cout << endl;
+
+    cout << "---------------------------------------------- internal before external" << endl;
+    // PING is queued behind START, but the steps START sets off go first
+    LoaderEvent event;
+    event.signal = SIG_START;
+    queue.push_back(&event);
+    event.signal = SIG_PING;
+    queue.push_back(&event);
+    dispatchAll(&loader, &queue, false);
+    cout << endl;
+
+    cout << "---------------------------------------------- full" << endl;
+    loader.init(TEST_STATE(&Loader::stateIDLE));
+    cout << endl;
+    event.signal = SIG_FLOOD;
+    loader.dispatch(&event);
+    cout << endl;
+}
+
+
+#endif
@@ -0,0 +1,3 @@
+// The internal test, with the machine derived from HSMStatic.
+#define TEST_STATIC
+#include "../internal/main.cpp"
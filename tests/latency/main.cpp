@@ -0,0 +1,121 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum Signals {
+    SIG_FAST = SIG_USER,
+    SIG_SLOW,
+    SIG_OTHER,
+};
+
+
+// a fake clock which the test (and handlers) move forward by hand
+Ticks now = 0;
+Ticks fakeClock() {
+    return now;
+}
+
+
+class Worker : public FSM {
+    public:
+        DispatchOutcome stateWORKING(const Event* event) {
+            switch (event->signal) {
+                case SIG_FAST:
+                    now += 1;
+                    return TW_HANDLED();
+                case SIG_SLOW:
+                    now += 100;
+                    return TW_HANDLED();
+                case SIG_OTHER:
+                    now += 5;
+                    return TW_HANDLED();
+            }
+            return TW_UNHANDLED();
+        }
+};
+
+
+void overrun(const FSM* machine, const Event* event, Ticks took) {
+    cout << "    overrun: signal " << int(event->signal - SIG_USER) << " took " << took << endl;
+}
+
+
+void print(const char* name, LatencyHistogram* histogram) {
+    cout << name << ": count " << histogram->count()
+        << " p50 " << histogram->percentile(50)
+        << " p90 " << histogram->percentile(90)
+        << " p99 " << histogram->percentile(99) << endl;
+}
+
+
+int main(int argc, const char* argv[]) {
+    cout << "---------------------------------------------- histogram" << endl;
+    LatencyHistogram histogram;
+    print("empty", &histogram);
+    for (Ticks t = 0; t < 100; t++) {
+        histogram.record(t);
+    }
+    print("0..99", &histogram);
+    histogram.record(0x7FFFFFFF);
+    cout << "p100 with a huge time: " << histogram.percentile(100) << endl;
+    histogram.clear();
+    for (uint32_t i = 0; i < 70000; i++) {
+        histogram.record(3);
+    }
+    cout << "saturated count: " << histogram.count() << endl;
+
+    cout << "---------------------------------------------- monitor" << endl;
+    Worker worker;
+    worker.init((State) &Worker::stateWORKING);
+    QueueRingBuffer<Event, 8> ring;
+    QueueTimestamped<8> queue(&ring, fakeClock);
+    LatencyHistogram waits[2];
+    LatencyHistogram steps[2];
+    // only FAST and SLOW are recorded
+    LatencyMonitor monitor(fakeClock, waits, steps, SIG_FAST, 2);
+    monitor.setBudget(50, overrun);
+
+    Event event;
+    for (uint8_t round = 0; round < 10; round++) {
+        // five fast events and (every other round) a slow one, pushed 10 ticks apart
+        for (uint8_t i = 0; i < 6; i++) {
+            event.signal = (i == 5 && round % 2) ? SIG_SLOW : SIG_FAST;
+            queue.push_back(&event);
+            now += 10;
+        }
+        event.signal = SIG_OTHER;
+        queue.push_back(&event);
+        dispatchAllMonitored(&worker, &queue, &monitor);
+    }
+    print("FAST waits", monitor.waits(SIG_FAST));
+    print("FAST steps", monitor.steps(SIG_FAST));
+    print("SLOW waits", monitor.waits(SIG_SLOW));
+    print("SLOW steps", monitor.steps(SIG_SLOW));
+    cout << "OTHER recorded: " << (monitor.steps(SIG_OTHER) ? "yes" : "no") << endl;
+    cout << "overruns: " << monitor.overruns() << endl;
+
+    cout << "---------------------------------------------- pop when empty" << endl;
+    // popping an empty queue doesn't move the stamps out of step
+    queue.pop_front();
+    queue.pop_front();
+    event.signal = SIG_FAST;
+    now = 1000;
+    queue.push_back(&event);
+    now = 1234;
+    queue.push_back(&event);
+    cout << "front stamp " << queue.frontStamp();
+    queue.pop_front();
+    cout << ", then " << queue.frontStamp() << endl;
+}
+
+
+#endif
@@ -0,0 +1,110 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+struct Reading : LinkedEvent {
+    uint16_t    value;
+};
+
+
+class Logger : public FSM {
+    public:
+        DispatchOutcome stateLOGGING(const Event* event) {
+            if (SIG_USER == event->signal) {
+                cout << static_cast<const Reading*>(event)->value << " ";
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+Reading pool[300];
+
+
+int main(int argc, const char* argv[]) {
+    for (uint16_t i = 0; i < 300; i++) {
+        pool[i].signal = SIG_USER;
+        pool[i].value = i;
+    }
+
+    cout << "---------------------------------------------- order" << endl;
+    QueueLinked queue;
+    cout << "empty size " << int(queue.size()) << (queue.front() ? " has front" : " no front") << endl;
+    queue.push(&pool[7]);
+    queue.push(&pool[3]);
+    queue.push(&pool[5]);
+    cout << "size " << int(queue.size()) << endl;
+    cout << "not copied " << (queue.front() == &pool[7] ? "yes" : "no") << endl;
+    Logger logger;
+    logger.init((State) &Logger::stateLOGGING);
+    dispatchAll(&logger, &queue, false);
+    cout << endl << "size " << int(queue.size()) << endl;
+    queue.pop_front();
+    cout << "pop when empty size " << int(queue.size()) << endl;
+
+    cout << "---------------------------------------------- reuse" << endl;
+    // an event can be pushed again once it has been popped
+    queue.push(&pool[1]);
+    queue.push(&pool[2]);
+    queue.pop_front();
+    queue.push(&pool[1]);
+    dispatchAll(&logger, &queue, false);
+    cout << endl;
+
+    cout << "---------------------------------------------- double push" << endl;
+    // an event that's already queued isn't linked in again
+    cout << "first " << (queue.push(&pool[4]) ? "pushed" : "rejected") << endl;
+    cout << "again " << (queue.push(&pool[4]) ? "pushed" : "rejected") << endl;
+    QueueLinked other;
+    cout << "into another queue " << (other.push(&pool[4]) ? "pushed" : "rejected") << endl;
+    cout << "size " << int(queue.size()) << " and " << int(other.size()) << endl;
+    // a copy of a queued event isn't queued
+    Reading copy = pool[4];
+    cout << "copy " << (other.push(&copy) ? "pushed" : "rejected") << endl;
+    // assigning to a queued event leaves it queued
+    copy = pool[5];
+    cout << "assigned " << (other.push(&copy) ? "pushed" : "rejected") << endl;
+    dispatchAll(&logger, &queue, false);
+    dispatchAll(&logger, &other, false);
+    cout << endl;
+    cout << "after popping " << (queue.push(&pool[4]) ? "pushed" : "rejected") << endl;
+    queue.pop_front();
+
+    cout << "---------------------------------------------- through IQueue" << endl;
+    // IQueue can't tell a LinkedEvent from any other Event, so it's rejected
+    IQueue* generic = &queue;
+    Event plain(SIG_USER);
+    generic->push_back(&plain);
+    generic->push_back(&pool[6]);
+    cout << "size " << int(queue.size()) << ", rejected " << queue.rejected() << endl;
+    cout << "sized " << (generic->push_back(&pool[6], sizeof(Reading)) ? "pushed" : "rejected") << endl;
+    cout << "typed " << (generic->push(pool[6]) ? "pushed" : "rejected") << endl;
+    cout << "size " << int(queue.size()) << ", rejected " << queue.rejected() << endl;
+
+    cout << "---------------------------------------------- no capacity" << endl;
+    QueueLinkedISR isrQueue;
+    for (uint16_t i = 0; i < 300; i++) {
+        isrQueue.push(&pool[i]);
+    }
+    cout << "size " << int(isrQueue.size()) << endl;
+    uint32_t sum = 0;
+    uint16_t count = 0;
+    while (isrQueue.size()) {
+        sum += static_cast<Reading*>(isrQueue.front())->value;
+        isrQueue.pop_front();
+        count++;
+    }
+    cout << "popped " << count << " sum " << sum << endl;
+}
+
+
+#endif
@@ -0,0 +1,151 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum Signals {
+    SIG_TICK = SIG_USER,    // Event
+    SIG_KEY,                // KeyEvent
+    SIG_PACKET,             // PacketEvent
+};
+
+
+struct KeyEvent : public Event {
+    uint8_t key;
+};
+
+struct PacketEvent : public Event {
+    uint32_t id;
+    uint8_t data[27];
+};
+
+
+class Printer : public FSM {
+    public:
+        DispatchOutcome statePRINTING(const Event* event) {
+            switch (event->signal) {
+                case SIG_TICK:
+                    cout << "tick;";
+                    return TW_HANDLED();
+                case SIG_KEY:
+                    cout << "key " << ((const KeyEvent*) event)->key << ";";
+                    return TW_HANDLED();
+                case SIG_PACKET: {
+                    const PacketEvent* packet = (const PacketEvent*) event;
+                    uint32_t sum = 0;
+                    for (uint8_t i = 0; i < sizeof(packet->data); i++) {
+                        sum += packet->data[i];
+                    }
+                    cout << "packet " << packet->id << " sum " << sum << ";";
+                    return TW_HANDLED();
+                }
+            }
+            return TW_UNHANDLED();
+        }
+};
+
+
+int main(int argc, const char* argv[]) {
+    Printer printer;
+    printer.init((State) &Printer::statePRINTING);
+    QueuePacked<96> queue;
+
+    Event tick;
+    tick.signal = SIG_TICK;
+    KeyEvent key;
+    key.signal = SIG_KEY;
+    PacketEvent packet;
+    packet.signal = SIG_PACKET;
+    for (uint8_t i = 0; i < sizeof(packet.data); i++) {
+        packet.data[i] = i;
+    }
+
+    cout << "---------------------------------------------- mixed" << endl;
+    queue.push(tick);
+    key.key = 'a';
+    queue.push(key);
+    packet.id = 1;
+    queue.push(packet);
+    queue.push_back(&tick);
+    cout << "size " << int(queue.size()) << ", front size " << int(queue.frontSize()) << endl;
+    dispatchAll(&printer, &queue, false);
+    cout << endl;
+
+    cout << "---------------------------------------------- full" << endl;
+    uint8_t pushed = 0;
+    while (queue.push(packet)) {
+        pushed++;
+    }
+    cout << "packets which fit " << int(pushed) << endl;
+    uint8_t keys = 0;
+    while (queue.push(key)) {
+        keys++;
+    }
+    cout << "then keys which fit " << int(keys) << endl;
+    dispatchAll(&printer, &queue, false);
+    cout << endl;
+
+    cout << "---------------------------------------------- wrap around" << endl;
+    // keep the previous round's events in the queue while the back wraps
+    // around many times, at a different offset each time
+    QueuePacked<160> wrapping;
+    uint32_t handled = 0;
+    uint32_t wrong = 0;
+    for (uint32_t round = 0; round < 100; round++) {
+        packet.id = round;
+        key.key = 'a' + (round % 26);
+        wrong += !wrapping.push(packet);
+        wrong += !wrapping.push(key);
+        if (round % 3) {
+            wrong += !wrapping.push(tick);
+        }
+        while (wrapping.size() > 3) {
+            Event* event = wrapping.front();
+            if (event->signal == SIG_PACKET && ((PacketEvent*) event)->id + 1 != round) {
+                wrong++;
+            }
+            wrapping.pop_front();
+            handled++;
+        }
+    }
+    cout << "handled " << handled << ", wrong " << wrong << ", left ";
+    dispatchAll(&printer, &wrapping, false);
+    cout << endl;
+
+    cout << "---------------------------------------------- through IQueue" << endl;
+    // push() is declared in IQueue, so the payload isn't lost through it
+    QueuePacked<96> through;
+    IQueue* generic = &through;
+    packet.id = 7;
+    key.key = 'q';
+    generic->push(packet);
+    generic->push(key);
+    generic->push_back(&tick);
+    cout << "front size " << int(through.frontSize()) << ", ";
+    dispatchAll(&printer, generic, false);
+    cout << endl;
+
+    cout << "---------------------------------------------- memory" << endl;
+    // room for 16 events, if at most two of them are packets
+    // (each event also takes a 4 byte header, and is padded to 4 bytes)
+    QueuePacked<2 * 40 + 14 * 8> mixed;
+    for (uint8_t i = 0; i < 16; i++) {
+        bool pushed = (i < 2) ? mixed.push(packet) : mixed.push(key);
+        if (!pushed) {
+            cout << "event " << int(i) << " didn't fit" << endl;
+        }
+    }
+    cout << "QueueRingBuffer<PacketEvent, 16> events: " << sizeof(PacketEvent) * 16 << " bytes" << endl;
+    cout << "QueuePacked with the same events: " << sizeof(mixed) - sizeof(QueuePackedCore) << " bytes" << endl;
+}
+
+
+#endif
@@ -71,8 +71,145 @@ void testRingBuffer() {
 }
 
 
+void testReserveCommit() {
+    cout << "------------------------------------- RESERVE COMMIT" << endl;
+    QueueRingBuffer<Event, 3> q;
+    Event* slot;
+
+    slot = q.reserve();
+    slot->signal = 20;
+    cout << "size " << int(q.size()) << " -- front " << debugEvent(q.front()) << endl;
+    q.commit();
+    cout << "size " << int(q.size()) << " -- front " << debugEvent(q.front()) << endl;
+    cout << "emplace " << q.emplace_back(21) << endl;
+    cout << "emplace " << q.emplace_back(22) << endl;
+    cout << "emplace " << q.emplace_back(23) << endl;
+    cout << "reserve " << debugEvent(q.reserve()) << endl;
+    q.commit();
+    cout << "size " << int(q.size()) << " -- front " << debugEvent(q.front()) << endl;
+    q.pop_front();
+    cout << "size " << int(q.size()) << " -- front " << debugEvent(q.front()) << endl;
+    // this wraps around
+    cout << "emplace " << q.emplace_back(24) << endl;
+    q.pop_front();
+    q.pop_front();
+    cout << "size " << int(q.size()) << " -- front " << debugEvent(q.front()) << endl;
+    q.pop_front();
+    cout << "size " << int(q.size()) << " -- front " << debugEvent(q.front()) << endl;
+
+    // without a reserve() (or once a push_back() has used the reserved
+    // slot) there is nothing to commit
+    QueueRingBuffer<Event, 3> r;
+    r.commit();
+    cout << "commit without reserve, size " << int(r.size()) << endl;
+    r.reserve();
+    Event e(25);
+    r.push_back(&e);
+    r.commit();
+    cout << "commit after push_back, size " << int(r.size()) << endl;
+    cout << endl;
+}
+
+
+struct Reading : Event {
+    uint16_t    value;
+
+    Reading() {}
+    Reading(uint8_t sig, uint16_t value) : Event(sig), value(value) {}
+};
+
+
+void testEmplaceDerived() {
+    cout << "------------------------------------- EMPLACE DERIVED" << endl;
+    QueueRingBuffer<Reading, 2> q;
+    int value = 1000;
+    cout << "emplace " << q.emplace_back(25, value) << endl;
+    cout << "emplace " << q.emplace_back(26, 2000) << endl;
+    cout << "emplace " << q.emplace_back(27, 3000) << endl;
+    while (q.size()) {
+        cout << "sig=" << int(q.front()->signal) << " value " << q.front()->value << endl;
+        q.pop_front();
+    }
+    cout << endl;
+}
+
+
+struct Big : Event {
+    uint8_t     payload[32];
+};
+
+
+void testDerivedEvents() {
+    cout << "------------------------------------- DERIVED EVENTS" << endl;
+    QueueRingBuffer<Big, 4> q;
+    IQueue* queue = &q;
+    Big big;
+    big.signal = 30;
+    memset(big.payload, 0xAB, sizeof(big.payload));
+    Event e;
+    e.signal = 31;
+
+    // a plain Event (as the Debouncer and time events post) only has its
+    // Event part copied, the rest of the slot is zeroed
+    queue->push_back(&e);
+    q.push_back(&big);
+    cout << "sized " << queue->push_back(&big, sizeof(Big)) << endl;
+    cout << "too big " << queue->push_back(&big, sizeof(Big) + 1) << endl;
+    while (q.size()) {
+        Big* front = q.front();
+        cout << "sig=" << int(front->signal) << " payload " << hex << int(front->payload[0]) << " " << int(front->payload[31]) << dec << endl;
+        q.pop_front();
+    }
+    cout << endl;
+}
+
+
+// prints the queue's events, emptying it
+void drain(IQueue* queue) {
+    while (queue->size()) {
+        cout << debugEvent(queue->front()) << " ";
+        queue->pop_front();
+    }
+    cout << endl;
+}
+
+
+// copies and assigns a queue, then deletes the original
+template <class Queue>
+void testCopyOf(const char* name) {
+    Queue* original = new Queue();
+    Event e;
+    e.signal = 40, original->push_back(&e);
+    e.signal = 41, original->push_back(&e);
+    Queue copy(*original);
+    Queue assigned;
+    assigned = *original;
+    delete original;
+    // the copies have their own events
+    e.signal = 42, copy.push_back(&e);
+    e.signal = 43, assigned.push_back(&e);
+    cout << name << " copy: ";
+    drain(&copy);
+    cout << name << " assigned: ";
+    drain(&assigned);
+}
+
+
+void testCopy() {
+    cout << "------------------------------------- COPY" << endl;
+    testCopyOf<QueueRingBuffer<Event, 4> >("ring buffer");
+    testCopyOf<QueuePacked<64> >("packed");
+    testCopyOf<QueueDoubleBuffer<Event, 4> >("double buffer");
+    cout << endl;
+}
+
+
 int main(int argc, const char* argv[]) {
     testRingBuffer();
+    testReserveCommit();
+    testEmplaceDerived();
+    testDerivedEvents();
+    testCopy();
 }
 
 
@@ -0,0 +1,131 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum {
+    SIG_NOISY = SIG_USER,   // limited to one per 10 ticks, in bursts of 3
+    SIG_SLOW,               // limited to one per 100 ticks, no bursts
+    SIG_OTHER,              // not limited
+    SIG_BUTTON              // not in the limits at all
+};
+
+const RateLimit limits[3] = {
+    { 10, 3 },
+    { 100, 1 },
+    { 0, 0 }
+};
+
+
+// a fake clock which the test moves forward by hand
+Ticks now = 0;
+Ticks fakeClock() {
+    return now;
+}
+
+
+class Counter : public FSM {
+    public:
+        uint16_t counts[4];
+        DispatchOutcome stateCOUNTING(const Event* event) {
+            if (event->signal >= SIG_NOISY && event->signal <= SIG_BUTTON) {
+                counts[event->signal - SIG_NOISY]++;
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+QueueRingBuffer<Event, 32> ring;
+QueueRateLimited<3> queue(&ring, fakeClock, limits, SIG_NOISY);
+Counter counter;
+
+
+void push(uint8_t signal) {
+    Event event;
+    event.signal = signal;
+    queue.push_back(&event);
+}
+
+
+// dispatches the queued events and prints how many of each there were
+void report(const char* name) {
+    for (uint8_t s = 0; s < 4; s++) {
+        counter.counts[s] = 0;
+    }
+    dispatchAll(&counter, &queue, false);
+    cout << name << ": noisy " << counter.counts[0] << " slow " << counter.counts[1];
+    cout << " other " << counter.counts[2] << " button " << counter.counts[3];
+    cout << " (dropped " << queue.dropped() << ")" << endl;
+}
+
+
+int main(int argc, const char* argv[]) {
+    counter.init((State) &Counter::stateCOUNTING);
+
+    cout << "---------------------------------------------- burst" << endl;
+    for (uint8_t e = 0; e < 10; e++) {
+        push(SIG_NOISY);
+        push(SIG_SLOW);
+        push(SIG_OTHER);
+        push(SIG_BUTTON);
+    }
+    report("t=0");
+
+    cout << "---------------------------------------------- refill" << endl;
+    // tokens are earned one interval after the last one (not after the push)
+    const Ticks times[] = { 5, 10, 15, 25, 30, 31, 100, 150, 199, 200 };
+    for (uint8_t t = 0; t < sizeof(times) / sizeof(times[0]); t++) {
+        now = times[t];
+        push(SIG_NOISY);
+        push(SIG_SLOW);
+        cout << "t=" << now << " noisy " << (ring.size() && ring.front()->signal == SIG_NOISY ? "pushed" : "dropped");
+        report("");
+    }
+
+    cout << "---------------------------------------------- idle" << endl;
+    // the bucket doesn't fill past the burst
+    now = 10000;
+    for (uint8_t e = 0; e < 10; e++) {
+        push(SIG_NOISY);
+    }
+    report("t=10000");
+
+    cout << "---------------------------------------------- flood" << endl;
+    // one noisy event every tick for 1000 ticks, and another signal every 50
+    uint16_t droppedBefore = queue.dropped();
+    uint16_t noisy = 0, other = 0;
+    for (uint16_t t = 1; t <= 1000; t++) {
+        now = 10000 + t;
+        push(SIG_NOISY);
+        if (t % 50 == 0) {
+            push(SIG_OTHER);
+        }
+        while (ring.size()) {
+            if (ring.front()->signal == SIG_NOISY) {
+                noisy++;
+            }
+            else {
+                other++;
+            }
+            ring.pop_front();
+        }
+    }
+    cout << "noisy " << noisy << " other " << other << " dropped " << (queue.dropped() - droppedBefore) << endl;
+    cout << "dropped by signal:";
+    for (uint8_t s = SIG_NOISY; s <= SIG_BUTTON; s++) {
+        cout << " " << queue.dropped(s);
+    }
+    cout << endl;
+}
+
+
+#endif
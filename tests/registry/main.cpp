@@ -0,0 +1,83 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+struct SessionEvent : Event {
+    uint8_t     sequence;
+};
+
+
+class Session : public FSM {
+    public:
+        uint32_t id;
+        uint32_t received;
+
+        Session() : id(0), received(0) {}
+
+        DispatchOutcome stateOPEN(const Event* event) {
+            if (SIG_USER == event->signal) {
+                received++;
+                cout << id << ":" << int(static_cast<const SessionEvent*>(event)->sequence) << " ";
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+int main(int argc, const char* argv[]) {
+    cout << "---------------------------------------------- ids" << endl;
+    MachineSlab<Session, 4> slab;
+    for (uint32_t i = 0; i < 6; i++) {
+        uint32_t id;
+        Session* session = slab.create(&id);
+        session->id = id;
+        session->init((State) &Session::stateOPEN);
+        cout << id << " ";
+    }
+    cout << "size " << slab.size() << endl;
+    slab.destroy(2);
+    slab.destroy(4);
+    slab.destroy(4);
+    cout << "after destroy size " << slab.size() << (slab.get(2) ? " 2 found" : " 2 not found") << endl;
+    uint32_t reused;
+    Session* session = slab.create(&reused);
+    session->id = reused;
+    session->init((State) &Session::stateOPEN);
+    cout << "reused " << reused << ", received " << session->received << ", size " << slab.size() << endl;
+    cout << "same chunk " << (slab.machine(5) == slab.machine(4) + 1 ? "yes" : "no") << endl;
+
+    cout << "---------------------------------------------- route" << endl;
+    // sessions 0 1 3 4 5 exist, 2 and 9 don't
+    const uint32_t ids[] = { 5, 0, 2, 5, 1, 0, 9, 3, 5, 0 };
+    SessionEvent events[10];
+    RoutedEvent batch[10];
+    for (uint8_t e = 0; e < 10; e++) {
+        events[e].signal = SIG_USER;
+        events[e].sequence = e;
+        batch[e].id = ids[e];
+        batch[e].event = &events[e];
+    }
+    uint32_t dispatched = slab.route(batch, 10);
+    cout << endl << "dispatched " << dispatched << endl;
+    dispatched = slab.route(batch + 5, 5);
+    cout << endl << "dispatched " << dispatched << endl;
+    for (uint32_t id = 0; id < 6; id++) {
+        if (slab.get(id)) {
+            cout << id << " received " << slab.machine(id)->received << endl;
+        }
+    }
+}
+
+
+#endif
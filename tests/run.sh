@@ -1,11 +1,20 @@
 #!/bin/bash
+#
+# Builds and runs each test, comparing its output with expected-output.txt.
+# A test can have a `flags` file with extra compiler flags (such as include
+# paths).
+#
 
 cd `dirname $0`
 tests=`ls -d * | grep -v run.sh`
 for test in $tests; do
     echo "=================================================== $test"
     cd $test
-    g++ -o main main.cpp || exit 1
+    flags=""
+    if [ -f flags ]; then
+        flags=`cat flags`
+    fi
+    g++ $flags -o main main.cpp || exit 1
     diff <(./main) expected-output.txt || exit 2
     cd ..
     echo "PASSED"
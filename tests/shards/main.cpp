@@ -0,0 +1,152 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <atomic>
+#include <iostream>
+#include <thread>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define SHARDS 3
+#define PER_SHARD 4
+#define MACHINES (SHARDS * PER_SHARD)
+#define HOPS 20000
+
+enum Signals {
+    SIG_TOKEN = SIG_USER,
+    SIG_COUNT,
+    SIG_PLAIN,
+};
+
+
+struct HopEvent : public Event {
+    uint32_t hops;
+};
+
+
+ShardGroup group(SHARDS, sizeof(HopEvent), 16, 8);
+ShardMachine* machines[MACHINES];
+atomic<uint32_t> handled(0);
+atomic<uint32_t> wrongThread(0);
+atomic<uint32_t> plainHops(1);
+
+
+class Hopper : public FSM {
+    public:
+        uint32_t index;
+        uint32_t tokens;
+        uint32_t counts;
+        thread::id owner;
+
+        DispatchOutcome stateHOPPING(const Event* event) {
+            if (event->signal < SIG_USER) {
+                return TW_HANDLED();
+            }
+            // a machine is only ever dispatched by its shard's thread
+            if (owner == thread::id()) {
+                owner = this_thread::get_id();
+            }
+            if (owner != this_thread::get_id()) {
+                wrongThread++;
+            }
+            if (SIG_COUNT == event->signal) {
+                counts++;
+            }
+            if (SIG_PLAIN == event->signal) {
+                plainHops = ((const HopEvent*) event)->hops;
+            }
+            if (SIG_TOKEN == event->signal) {
+                tokens++;
+                HopEvent hop = *(const HopEvent*) event;
+                if (++hop.hops < HOPS) {
+                    // alternately to a machine on this shard and on the next one
+                    // (nothing else is posted meanwhile, so the queue has room)
+                    uint32_t next = (hop.hops & 1) ? (index + SHARDS) % MACHINES : (index + 1) % MACHINES;
+                    group.post(machines[next], &hop, sizeof(hop));
+                }
+            }
+            handled++;
+            return TW_HANDLED();
+        }
+};
+
+
+Hopper hoppers[MACHINES];
+QueueRingBuffer<HopEvent, 8> queues[MACHINES];
+
+
+int main(int argc, const char* argv[]) {
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        hoppers[m].index = m;
+        hoppers[m].tokens = 0;
+        hoppers[m].counts = 0;
+        hoppers[m].init((State) &Hopper::stateHOPPING);
+        // machine m is on shard m % SHARDS
+        machines[m] = group.add(m % SHARDS, &hoppers[m], &queues[m]);
+    }
+    group.start(false);
+
+    HopEvent count;
+    count.signal = SIG_COUNT;
+    count.hops = 0;
+    for (uint32_t i = 0; i < 1000; i++) {
+        for (uint32_t m = 0; m < MACHINES; m++) {
+            while (! group.post(machines[m], &count, sizeof(count))) {
+                this_thread::yield();
+            }
+        }
+    }
+
+    while (handled.load() < 1000 * MACHINES) {
+        this_thread::yield();
+    }
+
+    // only the Event part of a plain Event is copied, the rest is zeroed
+    Event plain;
+    plain.signal = SIG_PLAIN;
+    group.post(machines[1], &plain);
+    while (handled.load() < 1000 * MACHINES + 1) {
+        this_thread::yield();
+    }
+
+    HopEvent token;
+    token.signal = SIG_TOKEN;
+    token.hops = 0;
+    bool oversized = group.post(machines[0], &token, sizeof(token) + 1);
+    group.post(machines[0], &token, sizeof(token));
+    while (handled.load() < 1000 * MACHINES + 1 + HOPS) {
+        this_thread::yield();
+    }
+    group.stop();
+
+    uint32_t tokens = 0;
+    uint32_t counts = 0;
+    for (uint32_t m = 0; m < MACHINES; m++) {
+        tokens += hoppers[m].tokens;
+        counts += hoppers[m].counts;
+    }
+    uint64_t dispatched = 0;
+    bool latencies = true;
+    for (uint32_t s = 0; s < SHARDS; s++) {
+        dispatched += group.dispatched(s);
+        latencies = latencies && group.latency(s, 50) <= group.latency(s, 99) && group.latency(s, 99) > 0;
+    }
+    cout << "token hops " << tokens << endl;
+    cout << "counted " << counts << endl;
+    cout << "dispatched " << dispatched << endl;
+    cout << "dispatched on the wrong thread " << wrongThread.load() << endl;
+    cout << "latencies " << (latencies ? "reported" : "MISSING") << endl;
+    cout << "plain event hops " << plainHops.load() << endl;
+    cout << "oversized post " << (oversized ? "ACCEPTED" : "refused") << endl;
+}
+
+
+#endif
@@ -0,0 +1,194 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+#include "../../src/TrimWrightHost.h"
+#include "../../src/TrimWrightHost.cpp"
+using namespace TrimWright;
+
+
+#define NAME "/trimwright-test-shmqueue"
+#define THREADS_NAME "/trimwright-test-shmqueue-threads"
+#define PRODUCERS 2
+#define EVENTS 100000
+
+enum Signals {
+    SIG_VALUE = SIG_USER,
+    SIG_DONE,
+};
+
+
+struct ValueEvent : public Event {
+    uint32_t producer;
+    uint32_t value;
+};
+
+
+class Summer : public FSM {
+    public:
+        uint64_t sum;
+        uint32_t count;
+        uint32_t done;
+        uint32_t next[PRODUCERS];
+        bool ordered;
+
+        DispatchOutcome stateSUMMING(const Event* event) {
+            const ValueEvent* value = (const ValueEvent*) event;
+            switch (event->signal) {
+                case SIG_VALUE:
+                    sum += value->value;
+                    count++;
+                    // each producer's events arrive in the order it sent them
+                    ordered = ordered && (value->value == next[value->producer]);
+                    next[value->producer]++;
+                    return TW_HANDLED();
+                case SIG_DONE:
+                    done++;
+                    return TW_HANDLED();
+            }
+            return TW_UNHANDLED();
+        }
+};
+
+
+void produce(uint32_t producer) {
+    QueueShared queue(NAME, sizeof(ValueEvent), 64, false);
+    if (! queue.ok()) {
+        _exit(1);
+    }
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        // write the event straight into the shared memory
+        ValueEvent* event;
+        while (! (event = (ValueEvent*) queue.reserve())) {
+            usleep(10);
+        }
+        event->signal = SIG_VALUE;
+        event->producer = producer;
+        event->value = i;
+        queue.commit(event);
+    }
+    ValueEvent done;
+    done.signal = SIG_DONE;
+    done.producer = producer;
+    queue.push_back(&done, sizeof(done));
+    _exit(0);
+}
+
+
+// threads reserving and committing through the same QueueShared object
+void produceShared(QueueShared* queue, uint32_t producer) {
+    for (uint32_t i = 0; i < EVENTS / 10; i++) {
+        ValueEvent* event;
+        while (! (event = (ValueEvent*) queue->reserve())) {
+            std::this_thread::yield();
+        }
+        event->signal = SIG_VALUE;
+        event->producer = producer;
+        event->value = i;
+        std::this_thread::yield();
+        queue->commit(event);
+    }
+    ValueEvent done;
+    done.signal = SIG_DONE;
+    done.producer = producer;
+    while (! queue->push_back(&done, sizeof(done))) {
+        std::this_thread::yield();
+    }
+}
+
+
+void testSharedObject() {
+    cout << endl << "---------------------------------------- threads sharing one object" << endl;
+    QueueShared queue(THREADS_NAME, sizeof(ValueEvent), 8, true);
+    std::thread threads[PRODUCERS];
+    for (uint32_t p = 0; p < PRODUCERS; p++) {
+        threads[p] = std::thread(produceShared, &queue, p);
+    }
+
+    Summer summer;
+    summer.sum = 0;
+    summer.count = 0;
+    summer.done = 0;
+    summer.ordered = true;
+    for (uint32_t p = 0; p < PRODUCERS; p++) {
+        summer.next[p] = 0;
+    }
+    summer.init((State) &Summer::stateSUMMING);
+    while (summer.done < PRODUCERS) {
+        dispatchAllOrWait(&summer, &queue, false, NULL, clockMillis, &queue);
+    }
+    for (uint32_t p = 0; p < PRODUCERS; p++) {
+        threads[p].join();
+    }
+    cout << "count " << summer.count << endl;
+    cout << "sum " << summer.sum << endl;
+    cout << "in order " << (summer.ordered ? "yes" : "no") << endl;
+}
+
+
+int main(int argc, const char* argv[]) {
+    QueueShared queue(NAME, sizeof(ValueEvent), 64, true);
+    cout << "created " << (queue.ok() ? "ok" : "FAILED") << endl;
+    QueueShared wrong(NAME, sizeof(Event), 64, false);
+    cout << "opened with the wrong event size " << (wrong.ok() ? "ok" : "failed") << endl;
+
+    // nothing committed yet
+    cout << "empty front " << (queue.front() ? "an event" : "NULL") << endl;
+    queue.pop_front();
+    cout << "empty size after pop_front " << (int) queue.size() << endl;
+    Event* reserved = queue.reserve();
+    reserved->signal = SIG_DONE;
+    cout << "reserved front " << (queue.front() ? "an event" : "NULL") << endl;
+    queue.pop_front();
+    queue.commit(reserved);
+    cout << "committed front " << (queue.front() ? (int) queue.front()->signal : -1) << endl;
+    queue.pop_front();
+    cout << "size after pop_front " << (int) queue.size() << endl;
+
+    pid_t children[PRODUCERS];
+    for (uint32_t p = 0; p < PRODUCERS; p++) {
+        children[p] = fork();
+        if (0 == children[p]) {
+            produce(p);
+        }
+    }
+
+    Summer summer;
+    summer.sum = 0;
+    summer.count = 0;
+    summer.done = 0;
+    summer.ordered = true;
+    for (uint32_t p = 0; p < PRODUCERS; p++) {
+        summer.next[p] = 0;
+    }
+    summer.init((State) &Summer::stateSUMMING);
+    while (summer.done < PRODUCERS) {
+        // sleeps on the futex whenever the queue is empty
+        dispatchAllOrWait(&summer, &queue, false, NULL, clockMillis, &queue);
+    }
+
+    int exited = 0;
+    for (uint32_t p = 0; p < PRODUCERS; p++) {
+        int status;
+        waitpid(children[p], &status, 0);
+        exited += WIFEXITED(status) && 0 == WEXITSTATUS(status);
+    }
+    cout << "producers exited ok " << exited << endl;
+    cout << "count " << summer.count << endl;
+    cout << "sum " << summer.sum << endl;
+    cout << "in order " << (summer.ordered ? "yes" : "no") << endl;
+
+    testSharedObject();
+}
+
+
+#endif
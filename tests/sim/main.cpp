@@ -0,0 +1,119 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+
+#include "../../extras/sim/TrimWrightSim.h"
+#include "../../extras/sim/TrimWrightSim.cpp"
+#include "../../src/TrimWright.cpp"
+
+// the example sketches, unmodified
+namespace blink {
+    #include "../../examples/blink/blink.ino"
+};
+namespace fsm {
+    #include "../../examples/fsm/fsm.ino"
+};
+namespace hsm {
+    #include "../../examples/hsm/hsm.ino"
+};
+namespace sleep {
+    #include "../../examples/sleep/sleep.ino"
+};
+
+
+void printWrite(uint8_t pin, uint8_t level, uint64_t us) {
+    std::cout << "    " << (us / 1000) << "ms pin " << int(pin) << " " << (level ? "HIGH" : "LOW") << std::endl;
+}
+
+
+// prints how many times the LED (pin 13) was turned on in each second
+uint32_t blinks = 0;
+uint8_t lastLevel = LOW;
+void countBlinks(uint8_t pin, uint8_t level, uint64_t us) {
+    if (13 == pin) {
+        blinks += (HIGH == level && LOW == lastLevel);
+        lastLevel = level;
+    }
+}
+void printBlinks(void (*setup)(), void (*loop)(), uint32_t seconds) {
+    TrimWrightSim::onPinWrite(countBlinks);
+    lastLevel = LOW;
+    for (uint32_t s = 0; s < seconds; s++) {
+        blinks = 0;
+        TrimWrightSim::run(setup, loop, 1000);
+        std::cout << "    second " << s << ": " << blinks << " blinks" << std::endl;
+    }
+}
+
+
+// the sleep sketch's loop(), counting the calls
+uint32_t sleepLoops = 0;
+void countSleepLoops() {
+    sleepLoops++;
+    sleep::loop();
+}
+
+
+int main(int argc, const char* argv[]) {
+    std::cout << "---------------------------------------------- blink" << std::endl;
+    TrimWrightSim::reset();
+    TrimWrightSim::onPinWrite(printWrite);
+    TrimWrightSim::run(blink::setup, blink::loop, 2200);
+    TrimWrightSim::onPinWrite(0);
+    // an hour of blinking
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    TrimWrightSim::run(blink::setup, blink::loop, 3600 * 1000);
+    double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+    std::cout << "after an hour: " << TrimWrightSim::pinWrites(13) << " writes, at " << (TrimWrightSim::now() / 1000) << "ms"
+        << (seconds < 60 ? " (faster than real time)" : " (TOO SLOW)") << std::endl;
+
+    std::cout << "---------------------------------------------- fsm" << std::endl;
+    TrimWrightSim::reset();
+    // press "up" (pin 11) at 1s and 2s, and "down" (pin 12) at 3s
+    TrimWrightSim::schedulePin(1000, 11, HIGH);
+    TrimWrightSim::schedulePin(1050, 11, LOW);
+    TrimWrightSim::schedulePin(2000, 11, HIGH);
+    TrimWrightSim::schedulePin(2050, 11, LOW);
+    TrimWrightSim::schedulePin(3000, 12, HIGH);
+    TrimWrightSim::schedulePin(3050, 12, LOW);
+    printBlinks(fsm::setup, fsm::loop, 5);
+
+    std::cout << "---------------------------------------------- hsm" << std::endl;
+    TrimWrightSim::reset();
+    // the button (pin 12) is down when LOW, start with it up
+    TrimWrightSim::setPin(12, HIGH);
+    // click twice (each click slows the blinking), then hold for a while
+    // (each repeat speeds it back up)
+    TrimWrightSim::schedulePin(1000, 12, LOW);
+    TrimWrightSim::schedulePin(1100, 12, HIGH);
+    // (the contacts bounce on the second click, which is debounced away)
+    TrimWrightSim::schedulePin(2000, 12, LOW);
+    TrimWrightSim::schedulePin(2001, 12, HIGH);
+    TrimWrightSim::schedulePin(2002, 12, LOW);
+    TrimWrightSim::schedulePin(2100, 12, HIGH);
+    TrimWrightSim::schedulePin(2102, 12, LOW);
+    TrimWrightSim::schedulePin(2103, 12, HIGH);
+    TrimWrightSim::schedulePin(4000, 12, LOW);
+    TrimWrightSim::schedulePin(5500, 12, HIGH);
+    printBlinks(hsm::setup, hsm::loop, 7);
+
+    std::cout << "---------------------------------------------- sleep" << std::endl;
+    TrimWrightSim::reset();
+    // press the button (pin 2) at 1s and 2s, then again after a second off
+    TrimWrightSim::schedulePin(1000, 2, HIGH);
+    TrimWrightSim::schedulePin(1050, 2, LOW);
+    TrimWrightSim::schedulePin(2000, 2, HIGH);
+    TrimWrightSim::schedulePin(2050, 2, LOW);
+    TrimWrightSim::schedulePin(3000, 2, HIGH);
+    TrimWrightSim::schedulePin(3050, 2, LOW);
+    printBlinks(sleep::setup, countSleepLoops, 5);
+    // each loop() sleeps until there is something to do, rather than polling
+    std::cout << "loops " << (sleepLoops < 100 ? "ok" : "TOO MANY") << std::endl;
+}
+
+
+#endif
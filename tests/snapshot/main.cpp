@@ -0,0 +1,156 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum {
+    SIG_A = SIG_USER,
+    SIG_B,
+    SIG_C
+};
+
+
+const char* signalName(uint8_t sig) {
+    if (sig == SIG_SUPER) { return "SUPER"; }
+    if (sig == SIG_ENTER) { return "ENTER"; }
+    if (sig == SIG_LEAVE) { return "LEAVE"; }
+    if (sig == SIG_INIT)  { return "INIT"; }
+    if (sig == SIG_IDLE)  { return "IDLE"; }
+    if (sig == SIG_A)     { return "A"; }
+    if (sig == SIG_B)     { return "B"; }
+    if (sig == SIG_C)     { return "C"; }
+    return "???";
+}
+
+
+class Machine : public HSM {
+    public:
+        static const State STATES[];
+        static const uint8_t STATE_COUNT = 4;
+
+        void debugDispatch(const Event* event, const char* stateName) {
+            if (SIG_SUPER == event->signal) {
+                return;
+            }
+            cout << stateName << "-" << signalName(event->signal) << ";";
+        }
+
+        DispatchOutcome stateOUTER(const Event* event) {
+            debugDispatch(event, "outer");
+            switch (event->signal) {
+                case SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateFIRST);
+                case SIG_C:
+                    return TW_TRANSITION(&Machine::stateOTHER);
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+            }
+            return TW_SUPER(&Machine::stateROOT);
+        }
+
+        DispatchOutcome stateFIRST(const Event* event) {
+            debugDispatch(event, "first");
+            switch (event->signal) {
+                case SIG_A:
+                    return TW_TRANSITION(&Machine::stateSECOND);
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+            }
+            return TW_SUPER(&Machine::stateOUTER);
+        }
+
+        DispatchOutcome stateSECOND(const Event* event) {
+            debugDispatch(event, "second");
+            switch (event->signal) {
+                case SIG_B:
+                    return TW_TRANSITION(&Machine::stateFIRST);
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+            }
+            return TW_SUPER(&Machine::stateOUTER);
+        }
+
+        DispatchOutcome stateOTHER(const Event* event) {
+            debugDispatch(event, "other");
+            switch (event->signal) {
+                case SIG_ENTER:
+                case SIG_LEAVE:
+                    return TW_HANDLED();
+            }
+            return TW_SUPER(&Machine::stateROOT);
+        }
+};
+const State Machine::STATES[] = {
+    (State) &Machine::stateOUTER,
+    (State) &Machine::stateFIRST,
+    (State) &Machine::stateSECOND,
+    (State) &Machine::stateOTHER
+};
+
+
+#define VERSION 3
+typedef QueueRingBuffer<Event, 4> Queue;
+typedef Snapshot<Event, 4> MachineSnapshot;
+
+
+void post(Queue* queue, uint8_t signal) {
+    Event e;
+    e.signal = signal;
+    queue->push_back(&e);
+}
+
+
+int main(int argc, const char* argv[]) {
+    MachineSnapshot snapshot;
+
+    cout << "---------------------------------------------- save" << endl;
+    {
+        Machine machine;
+        Queue queue;
+        machine.init((State) &Machine::stateOUTER);
+        cout << endl;
+        post(&queue, SIG_A);
+        dispatchAll(&machine, &queue, false);
+        cout << endl;
+        // wrap the ring buffer around before saving
+        post(&queue, SIG_B);
+        post(&queue, SIG_B);
+        post(&queue, SIG_B);
+        queue.pop_front();
+        queue.pop_front();
+        post(&queue, SIG_C);
+        post(&queue, SIG_A);
+        saveSnapshot(&snapshot, VERSION, &machine, Machine::STATES, Machine::STATE_COUNT, &queue);
+        cout << "state " << int(snapshot.state) << " size " << int(snapshot.size) << endl;
+    }
+
+    cout << "---------------------------------------------- restore" << endl;
+    {
+        Machine machine;
+        Queue queue;
+        cout << "wrong version " << restoreSnapshot(&snapshot, VERSION + 1, &machine, Machine::STATES, Machine::STATE_COUNT, &queue) << endl;
+        snapshot.events[0].signal ^= 1;
+        cout << "corrupt " << restoreSnapshot(&snapshot, VERSION, &machine, Machine::STATES, Machine::STATE_COUNT, &queue) << endl;
+        snapshot.events[0].signal ^= 1;
+        cout << "ok " << restoreSnapshot(&snapshot, VERSION, &machine, Machine::STATES, Machine::STATE_COUNT, &queue) << endl;
+        cout << "size " << int(queue.size()) << endl;
+        dispatchAll(&machine, &queue, false);
+        cout << endl;
+        cout << "state " << int(machine.stateId(Machine::STATES, Machine::STATE_COUNT)) << endl;
+        cout << "bad id " << machine.resume(Machine::STATES, Machine::STATE_COUNT, 7) << endl;
+    }
+}
+
+
+#endif
@@ -0,0 +1,150 @@
+// if building a real arduino program than no-op this file
+#ifndef ARDUINO
+
+
+#include <stdint.h>
+#include <iostream>
+#include <unistd.h>
+using namespace std;
+
+#include "../../src/TrimWright.h"
+#include "../../src/TrimWright.cpp"
+using namespace TrimWright;
+
+
+enum {
+    SIG_PING = SIG_USER,
+    SIG_CLICK,
+    SIG_READING
+};
+
+struct Click : Event {
+    uint8_t     button;
+};
+
+struct Reading : Event {
+    uint8_t     channel;
+    uint16_t    value;
+};
+
+
+class Logger : public FSM {
+    public:
+        DispatchOutcome stateLOGGING(const Event* event) {
+            switch (event->signal) {
+                case SIG_PING:
+                    cout << "ping ";
+                    return TW_HANDLED();
+                case SIG_CLICK:
+                    cout << "click(" << int(static_cast<const Click*>(event)->button) << ") ";
+                    return TW_HANDLED();
+                case SIG_READING: {
+                    const Reading* reading = static_cast<const Reading*>(event);
+                    cout << "reading(" << int(reading->channel) << "," << reading->value << ") ";
+                    return TW_HANDLED();
+                }
+            }
+            return TW_HANDLED();
+        }
+};
+
+
+// writes all the frames for the test into the pipe
+void writeFrames(int fd) {
+    uint8_t frame[16];
+    uint16_t size;
+
+    Event ping;
+    ping.signal = SIG_PING;
+    Click click;
+    click.signal = SIG_CLICK;
+    click.button = 3;
+    Reading reading;
+    reading.signal = SIG_READING;
+    reading.channel = 1;
+    reading.value = 1000;
+
+    size = encodeFrame(frame, ping);
+    write(fd, frame, size);
+    size = encodeFrame(frame, click);
+    write(fd, frame, size);
+    size = encodeFrame(frame, reading);
+    write(fd, frame, size);
+
+    // noise between frames
+    uint8_t noise[] = { 0x00, 0x12, 0xFF };
+    write(fd, noise, sizeof(noise));
+
+    // a corrupted frame
+    reading.value = 2000;
+    size = encodeFrame(frame, reading);
+    frame[4] ^= 0x01;
+    write(fd, frame, size);
+
+    // a frame which is too long for the decoder's events
+    uint8_t huge[] = { TW_FRAME_SYNC, 9, SIG_PING, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    write(fd, huge, sizeof(huge));
+
+    reading.value = 3000;
+    size = encodeFrame(frame, reading);
+    write(fd, frame, size);
+
+    // a frame cut short, so the next frame starts inside it (which is only
+    // found if the decoder gets it all at once)
+    size = encodeFrame(frame, click);
+    write(fd, frame, 2);
+    click.button = 4;
+    size = encodeFrame(frame, click);
+    write(fd, frame, size);
+}
+
+
+int main(int argc, const char* argv[]) {
+    cout << "---------------------------------------------- crc" << endl;
+    cout << "check " << hex << int(frameCrc(0, "123456789", 9)) << dec << endl;
+    uint8_t frame[8];
+    Click click;
+    click.signal = SIG_CLICK;
+    click.button = 7;
+    uint16_t size = encodeFrame(frame, click);
+    cout << "click frame";
+    for (uint16_t i = 0; i < size; i++) {
+        cout << " " << hex << int(frame[i]) << dec;
+    }
+    cout << endl;
+
+    QueueRingBuffer<Reading, 8> queue;
+    FrameDecoder<Reading> decoder(&queue);
+    Logger logger;
+    logger.init((State) &Logger::stateLOGGING);
+
+    for (size_t chunk : { 3, 5, 1, 64 }) {
+        cout << "---------------------------------------------- reads of " << chunk << endl;
+        int fds[2];
+        if (pipe(fds)) {
+            return 1;
+        }
+        writeFrames(fds[1]);
+        close(fds[1]);
+        uint8_t bytes[64];
+        ssize_t got;
+        while ((got = read(fds[0], bytes, chunk)) > 0) {
+            decoder.decode(bytes, got);
+            dispatchAll(&logger, &queue, false);
+        }
+        close(fds[0]);
+        cout << endl;
+        cout << "frames " << decoder.frames() << " errors " << decoder.errors() << endl;
+    }
+
+    cout << "---------------------------------------------- reset" << endl;
+    size = encodeFrame(frame, click);
+    decoder.decode(frame, 3);
+    decoder.reset();
+    decoder.decode(frame, size);
+    dispatchAll(&logger, &queue, false);
+    cout << endl;
+}
+
+
+#endif
@@ -0,0 +1,34 @@
+// FSM only, two states
+#include "../../src/TrimWright.cpp"
+
+enum {
+    SIG_TOGGLE = TrimWright::SIG_USER
+};
+
+class Machine : public TrimWright::FSM {
+    public:
+        TrimWright::DispatchOutcome stateON(const TrimWright::Event* event) {
+            switch (event->signal) {
+                case SIG_TOGGLE:
+                    return TW_TRANSITION(&Machine::stateOFF);
+                default:
+                    return TW_HANDLED();
+            }
+        }
+        TrimWright::DispatchOutcome stateOFF(const TrimWright::Event* event) {
+            switch (event->signal) {
+                case SIG_TOGGLE:
+                    return TW_TRANSITION(&Machine::stateON);
+                default:
+                    return TW_HANDLED();
+            }
+        }
+} machine;
+
+extern "C" void sizeSetup() {
+    machine.init((TrimWright::State) &Machine::stateON);
+}
+
+extern "C" void sizeLoop(const TrimWright::Event* event) {
+    machine.dispatch(event);
+}
@@ -0,0 +1,3 @@
+// HSM with a deeper maximum state depth
+#define TRIMWRIGHT_MAX_STATE_DEPTH 12
+#include "hsm.cpp"
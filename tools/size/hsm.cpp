@@ -0,0 +1,50 @@
+// HSM, three levels deep
+#include "../../src/TrimWright.cpp"
+
+enum {
+    SIG_TOGGLE = TrimWright::SIG_USER,
+    SIG_RESET
+};
+
+class Machine : public TrimWright::HSM {
+    public:
+        TrimWright::DispatchOutcome stateTOP(const TrimWright::Event* event) {
+            switch (event->signal) {
+                case TrimWright::SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateON);
+                case SIG_RESET:
+                    return TW_TRANSITION(&Machine::stateTOP);
+                default:
+                    return TW_SUPER(&Machine::stateROOT);
+            }
+        }
+        TrimWright::DispatchOutcome stateON(const TrimWright::Event* event) {
+            switch (event->signal) {
+                case TrimWright::SIG_INIT:
+                    return TW_TRANSITION(&Machine::stateONLEAF);
+                case SIG_TOGGLE:
+                    return TW_TRANSITION(&Machine::stateOFF);
+                default:
+                    return TW_SUPER(&Machine::stateTOP);
+            }
+        }
+        TrimWright::DispatchOutcome stateONLEAF(const TrimWright::Event* event) {
+            return TW_SUPER(&Machine::stateON);
+        }
+        TrimWright::DispatchOutcome stateOFF(const TrimWright::Event* event) {
+            switch (event->signal) {
+                case SIG_TOGGLE:
+                    return TW_TRANSITION(&Machine::stateON);
+                default:
+                    return TW_SUPER(&Machine::stateTOP);
+            }
+        }
+} machine;
+
+extern "C" void sizeSetup() {
+    machine.init((TrimWright::State) &Machine::stateTOP);
+}
+
+extern "C" void sizeLoop(const TrimWright::Event* event) {
+    machine.dispatch(event);
+}
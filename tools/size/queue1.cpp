@@ -0,0 +1,12 @@
+// one queue instantiation, drained by dispatchAll()
+#include "../../src/TrimWright.cpp"
+
+TrimWright::QueueRingBuffer<TrimWright::Event, 8> queue1;
+
+extern "C" void sizePost(TrimWright::Event* event) {
+    queue1.push_back(event);
+}
+
+extern "C" void sizeLoop(TrimWright::FSM* machine) {
+    TrimWright::dispatchAll(machine, &queue1, true);
+}
@@ -0,0 +1,28 @@
+// six queue instantiations, drained by dispatchAll()
+#include "../../src/TrimWright.cpp"
+
+
+TrimWright::QueueRingBuffer<TrimWright::Event, 4> queue1;
+TrimWright::QueueRingBuffer<TrimWright::Event, 8> queue2;
+TrimWright::QueueRingBuffer<TrimWright::Event, 16> queue3;
+TrimWright::QueueRingBuffer<TrimWright::Event, 6> queue4;
+TrimWright::QueueRingBuffer<TrimWright::Event, 10> queue5;
+TrimWright::QueueRingBuffer<TrimWright::Event, 12> queue6;
+
+extern "C" void sizePost(TrimWright::Event* event) {
+    queue1.push_back(event);
+    queue2.push_back(event);
+    queue3.push_back(event);
+    queue4.push_back(event);
+    queue5.push_back(event);
+    queue6.push_back(event);
+}
+
+extern "C" void sizeLoop(TrimWright::FSM* machine) {
+    TrimWright::dispatchAll(machine, &queue1, true);
+    TrimWright::dispatchAll(machine, &queue2, true);
+    TrimWright::dispatchAll(machine, &queue3, true);
+    TrimWright::dispatchAll(machine, &queue4, true);
+    TrimWright::dispatchAll(machine, &queue5, true);
+    TrimWright::dispatchAll(machine, &queue6, true);
+}
@@ -0,0 +1,74 @@
+#!/bin/bash
+#
+# Compiles each configuration (*.cpp in this directory) at -Os and reports
+# its code size (text/data/bss) per symbol, plus the stack used by
+# HSM::dispatch(). Fails if any budget (in budgets.txt) is exceeded.
+#
+# Each configuration exposes its entry points as extern "C" functions whose
+# names start with "size", anything not reachable from those is discarded.
+#
+# The compiler can be changed, for example to measure for an AVR:
+#   CXX=avr-g++ CXXFLAGS="-mmcu=atmega328p" BUDGETS=budgets-avr.txt ./run.sh
+#
+
+cd `dirname $0`
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-}
+BUDGETS=${BUDGETS:-budgets.txt}
+NM=${NM:-`echo $CXX | sed -e 's/g++$/nm/' -e 's/^g++$/nm/'`}
+SIZE=${SIZE:-`echo $CXX | sed -e 's/g++$/size/' -e 's/^g++$/size/'`}
+OUT=`mktemp -d`
+trap "rm -rf $OUT" EXIT
+
+failed=0
+
+# checks a measurement against the budget, if there is one
+# usage: budget config metric value
+budget() {
+    local max=`awk -v c="$1" -v m="$2" '$1 == c && $2 == m { print $3 }' $BUDGETS`
+    if [ -z "$max" ]; then
+        printf "    %-28s %6d\n" "$2" "$3"
+    elif [ "$3" -gt "$max" ]; then
+        printf "    %-28s %6d  OVER BUDGET (%d)\n" "$2" "$3" "$max"
+        failed=1
+    else
+        printf "    %-28s %6d  (budget %d)\n" "$2" "$3" "$max"
+    fi
+}
+
+for src in *.cpp; do
+    config=`basename $src .cpp`
+    echo "=================================================== $config"
+    $CXX $CXXFLAGS -std=gnu++11 -Os -ffunction-sections -fdata-sections -fno-exceptions \
+        -fno-threadsafe-statics -fstack-usage -c -o $OUT/$config.o $src || exit 1
+    mv $config.su $OUT/ 2>/dev/null
+
+    # Only keep what is reachable from the entry points of the configuration
+    # (the extern "C" size* functions), like the final firmware link would.
+    roots=`$NM $OUT/$config.o | awk '$2 == "T" && $3 ~ /^size/ { printf "-Wl,-u,%s ", $3 }'`
+    $CXX $CXXFLAGS -r -nostdlib -Wl,--gc-sections $roots \
+        -o $OUT/$config.linked.o $OUT/$config.o || exit 1
+
+    # per symbol: size, type (t=text d=data b=bss r=rodata w/v=weak), name
+    $NM -S -t d -C --size-sort $OUT/$config.linked.o | \
+        awk '{ size = $2 + 0; $1 = ""; $2 = ""; sub(/^ +/, ""); printf "    %6d %s\n", size, $0 }'
+
+    # totals
+    set -- `$SIZE $OUT/$config.linked.o | tail -1`
+    budget $config text $1
+    budget $config data $2
+    budget $config bss $3
+
+    # stack depth of HSM::dispatch() (if it is used), which is the frame of
+    # the engine's dispatch() that HSM::dispatch() tail-calls
+    $NM $OUT/$config.linked.o | grep -q '_ZN10TrimWright3HSM8dispatch' || continue
+    stack=`grep 'HSMEngine<.*>::dispatch(.*Machine = TrimWright::HSM;' $OUT/$config.su | awk -F'\t' '{ print $2 }' | head -1`
+    if [ -n "$stack" ]; then
+        budget $config stack:HSM::dispatch $stack
+    fi
+done
+
+if [ $failed != 0 ]; then
+    echo "SIZE BUDGET EXCEEDED"
+    exit 1
+fi
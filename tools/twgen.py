@@ -0,0 +1,549 @@
+#!/usr/bin/env python3
+#
+# Copyright 2019 Drew Folta <drew@folta.net>
+# Licensed under the MIT License, see LICENSE.txt for details.
+#
+# Generates a table-driven TrimWright state machine from a state chart
+# written in a small text DSL (or a subset of SCXML).
+#
+# The state hierarchy is resolved when the header is generated: for each
+# (state, signal) pair the bubbling, guards, exit actions, transition action,
+# entry actions and initial transitions are all computed ahead of time, so
+# dispatching an event is a table lookup followed by a list of action calls.
+#
+# usage:
+#   tools/twgen.py machine.tw > machine.h
+#   tools/twgen.py --stubs machine.tw       (prints a skeleton of the actions)
+#
+# DSL
+#   # comment
+#   machine NAME                    name of the generated class (NAME + "Machine")
+#   signal NAME [= VALUE]           signals, numbered consecutively from SIG_USER
+#                                   (or from the VALUE given to the first one)
+#   initial NAME                    initial state (of the machine, or of the
+#                                   enclosing state when indented under it)
+#   state NAME [entry] [exit]       a state, and whether it has entry and/or
+#                                   exit actions (enter_NAME() and exit_NAME())
+#   SIGNAL [-> TARGET] [[GUARD]] [/ ACTION]
+#                                   a transition of the enclosing state, or an
+#                                   internal transition if there is no target
+#   Substates (and the transitions of a state) are indented under it.
+#
+# SCXML (subset)
+#   <scxml name initial>, <state id initial>, <initial><transition target/>,
+#   <transition event target cond> (cond is the name of a guard),
+#   a <script> inside a transition names its action,
+#   <onentry> and <onexit> (their content isn't used, only their presence).
+#
+
+import os
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+NONE = 0xFF
+
+
+class ChartError(Exception):
+    pass
+
+
+class State:
+    def __init__(self, name, parent):
+        self.name = name
+        self.parent = parent
+        self.children = []
+        self.initial = None
+        self.entry = False
+        self.exit = False
+        self.transitions = []   # (signal, target or None, guard, action)
+
+
+class Chart:
+    def __init__(self):
+        self.name = None
+        self.signals = []       # (name, value or None)
+        self.states = []        # in declaration order
+        self.initial = None
+
+    def state(self, name):
+        for s in self.states:
+            if s.name == name:
+                return s
+        raise ChartError('unknown state "%s"' % name)
+
+    def ancestors(self, s):
+        # s and all of its parents, innermost first
+        out = []
+        while s:
+            out.append(s)
+            s = s.parent
+        return out
+
+
+#--------------------------------------------------------------------------
+# parsing
+#
+
+TRANSITION = re.compile(r'^(\w+)\s*(?:->\s*(\w+))?\s*(?:\[\s*(\w+)\s*\])?\s*(?:/\s*(\w+))?$')
+
+
+def parseDSL(text):
+    chart = Chart()
+    stack = []      # (indent, state)
+    initials = []   # (state or None, name, line number)
+    for number, line in enumerate(text.splitlines(), 1):
+        stripped = line.split('#', 1)[0].rstrip()
+        if not stripped.strip():
+            continue
+        indent = len(stripped) - len(stripped.lstrip())
+        words = stripped.split()
+        while stack and stack[-1][0] >= indent:
+            stack.pop()
+        parent = stack[-1][1] if stack else None
+        try:
+            if words[0] == 'machine' and len(words) == 2:
+                chart.name = words[1]
+            elif words[0] == 'signal':
+                m = re.match(r'^signal\s+(\w+)\s*(?:=\s*(\w+))?$', stripped.strip())
+                if not m:
+                    raise ChartError('bad signal')
+                if m.group(2) and chart.signals:
+                    raise ChartError('only the first signal can have a value')
+                chart.signals.append((m.group(1), m.group(2)))
+            elif words[0] == 'initial' and len(words) == 2:
+                initials.append((parent, words[1], number))
+            elif words[0] == 'state' and len(words) >= 2:
+                s = State(words[1], parent)
+                for flag in words[2:]:
+                    if flag == 'entry':
+                        s.entry = True
+                    elif flag == 'exit':
+                        s.exit = True
+                    else:
+                        raise ChartError('unknown state flag "%s"' % flag)
+                if parent:
+                    parent.children.append(s)
+                chart.states.append(s)
+                stack.append((indent, s))
+            else:
+                m = TRANSITION.match(stripped.strip())
+                if not m or not parent:
+                    raise ChartError('syntax error')
+                parent.transitions.append(m.groups())
+        except ChartError as e:
+            raise ChartError('line %d: %s' % (number, e))
+    for parent, name, number in initials:
+        try:
+            if parent:
+                parent.initial = chart.state(name)
+            else:
+                chart.initial = chart.state(name)
+        except ChartError as e:
+            raise ChartError('line %d: %s' % (number, e))
+    return chart
+
+
+def parseSCXML(text):
+    def local(tag):
+        return tag.split('}', 1)[-1]
+
+    chart = Chart()
+    root = ET.fromstring(text)
+    chart.name = root.get('name')
+    signals = []
+    initials = []   # (state or None, name)
+
+    def walk(element, parent):
+        for child in element:
+            tag = local(child.tag)
+            if tag == 'state':
+                s = State(child.get('id'), parent)
+                if parent:
+                    parent.children.append(s)
+                chart.states.append(s)
+                if child.get('initial'):
+                    initials.append((s, child.get('initial')))
+                walk(child, s)
+            elif tag == 'initial' and parent:
+                for t in child:
+                    if local(t.tag) == 'transition':
+                        initials.append((parent, t.get('target')))
+            elif tag == 'onentry' and parent:
+                parent.entry = True
+            elif tag == 'onexit' and parent:
+                parent.exit = True
+            elif tag == 'transition' and parent:
+                action = None
+                for script in child:
+                    if local(script.tag) == 'script':
+                        action = (script.text or '').strip()
+                for event in (child.get('event') or '').split():
+                    if event not in signals:
+                        signals.append(event)
+                    parent.transitions.append((event, child.get('target'), child.get('cond'), action))
+
+    walk(root, None)
+    chart.signals = [(s, None) for s in signals]
+    if root.get('initial'):
+        initials.append((None, root.get('initial')))
+    elif chart.states:
+        chart.initial = [s for s in chart.states if not s.parent][0]
+    for parent, name in initials:
+        if parent:
+            parent.initial = chart.state(name)
+        else:
+            chart.initial = chart.state(name)
+    return chart
+
+
+#--------------------------------------------------------------------------
+# resolving the transitions
+#
+
+def initialChain(chart, s):
+    # the states entered by the initial transitions of s (not including s)
+    entered = []
+    while s.initial:
+        target = s.initial
+        path = []
+        t = target
+        while t is not s:
+            if t is None:
+                raise ChartError('initial state "%s" isn\'t inside "%s"' % (target.name, s.name))
+            path.append(t)
+            t = t.parent
+        entered.extend(reversed(path))
+        s = target
+    return entered, s
+
+
+def resolve(chart, leaf, source, target):
+    # Returns (exited, entered, final) for a transition from `source` (which
+    # contains `leaf`, the current state) to `target`, following the same
+    # rules as TrimWright::HSM::dispatch().
+    exited = []
+    s = leaf
+    while s is not source:
+        exited.append(s)
+        s = s.parent
+    if source is target:
+        exited.append(source)
+        entered = [target]
+    else:
+        path = chart.ancestors(target)
+        entered = None
+        s = source
+        while s:
+            if s is target:
+                # local transition to an ancestor
+                entered = []
+                break
+            if s in path:
+                entered = list(reversed(path[:path.index(s)]))
+                break
+            exited.append(s)
+            s = s.parent
+        if entered is None:
+            entered = list(reversed(path))
+    more, final = initialChain(chart, target)
+    return exited, entered + more, final
+
+
+class Tables:
+    def __init__(self, chart):
+        self.chart = chart
+        self.actions = []   # method names, action id is index + 1
+        self.guards = []    # method names, guard id is index + 1
+        self.ops = []       # action ids
+        self.candidates = []
+        self.rows = []      # per state, per signal: first candidate index
+        self.signals = [name for name, value in chart.signals]
+        self.build()
+
+    def actionId(self, name):
+        if name not in self.actions:
+            self.actions.append(name)
+        return self.actions.index(name) + 1
+
+    def guardId(self, name):
+        if not name:
+            return 0
+        if name not in self.guards:
+            self.guards.append(name)
+        return self.guards.index(name) + 1
+
+    def addOps(self, exited, action, entered):
+        ops = []
+        for s in exited:
+            if s.exit:
+                ops.append(self.actionId('exit_' + s.name))
+        if action:
+            ops.append(self.actionId(action))
+        for s in entered:
+            if s.entry:
+                ops.append(self.actionId('enter_' + s.name))
+        begin = len(self.ops)
+        self.ops.extend(ops)
+        return begin, len(self.ops)
+
+    def build(self):
+        chart = self.chart
+        # give the entry/exit actions the lowest ids, in declaration order
+        for s in chart.states:
+            if s.entry:
+                self.actionId('enter_' + s.name)
+            if s.exit:
+                self.actionId('exit_' + s.name)
+        for s in chart.states:
+            row = []
+            for signal in self.signals:
+                first = NONE
+                previous = None
+                hidden = False
+                for source in chart.ancestors(s):
+                    for sig, target, guard, action in source.transitions:
+                        if sig not in self.signals:
+                            raise ChartError('state "%s": unknown signal "%s"' % (source.name, sig))
+                        if sig != signal:
+                            continue
+                        if target:
+                            exited, entered, final = resolve(chart, s, source, chart.state(target))
+                            begin, end = self.addOps(exited, action, entered)
+                            final = chart.states.index(final)
+                        else:
+                            begin, end = self.addOps([], action, [])
+                            final = NONE
+                        self.candidates.append([self.guardId(guard), begin, end, final, NONE])
+                        index = len(self.candidates) - 1
+                        if previous is None:
+                            first = index
+                        else:
+                            self.candidates[previous][4] = index
+                        previous = index
+                        if not guard:
+                            # an unguarded transition hides the later ones
+                            hidden = True
+                            break
+                    if hidden:
+                        break
+                row.append(first)
+            self.rows.append(row)
+        if len(self.candidates) >= NONE:
+            raise ChartError('too many transitions')
+        if not chart.initial:
+            raise ChartError('no initial state')
+        if not self.signals:
+            raise ChartError('no signals')
+        entered = list(reversed(chart.ancestors(chart.initial)))
+        more, final = initialChain(chart, chart.initial)
+        self.start = self.addOps([], None, entered + more)
+        self.startState = chart.states.index(final)
+
+
+#--------------------------------------------------------------------------
+# output
+#
+
+def cName(name):
+    return re.sub(r'\W', '_', name).upper()
+
+
+def generate(chart, source, include):
+    t = Tables(chart)
+    name = chart.name or 'Chart'
+    ns = name + 'Tables'
+    out = []
+    w = out.append
+    guardName = 'TW_GEN_%s_H' % cName(name)
+    w('// Generated by tools/twgen.py from %s, do not edit.' % os.path.basename(source))
+    w('')
+    w('#ifndef %s' % guardName)
+    w('#define %s' % guardName)
+    w('')
+    w('#include "%s"' % include)
+    w('')
+    w('namespace %s {' % ns)
+    w('')
+    w('    enum : uint8_t {')
+    for i, (sig, value) in enumerate(chart.signals):
+        if i == 0 and not value:
+            value = 'TrimWright::SIG_USER'
+        w('        SIG_%s%s,' % (cName(sig), (' = ' + value) if value else ''))
+    w('    };')
+    w('')
+    w('    enum : uint8_t {')
+    for s in chart.states:
+        w('        STATE_%s,' % cName(s.name))
+    w('        STATE_COUNT')
+    w('    };')
+    w('')
+    w('    const uint8_t NONE = 0x%02X;' % NONE)
+    w('    const uint8_t SIGNAL_COUNT = %d;' % len(t.signals))
+    w('')
+    w('    // signals are numbered consecutively, so SIG_X is column (SIG_X - SIGNAL_FIRST) of ROWS')
+    w('    const uint8_t SIGNAL_FIRST = SIG_%s;' % cName(t.signals[0]))
+    w('')
+    w('    constexpr uint8_t PARENT[STATE_COUNT] = {')
+    for s in chart.states:
+        parent = ('STATE_' + cName(s.parent.name)) if s.parent else 'NONE'
+        w('        %s,%s// %s' % (parent, ' ' * max(1, 24 - len(parent)), s.name))
+    w('    };')
+    w('')
+    w('    struct Candidate {')
+    w('        uint8_t     guard;  // 0 if none')
+    w('        uint16_t    begin;  // actions to run are OPS[begin] to OPS[end-1]')
+    w('        uint16_t    end;')
+    w('        uint8_t     next;   // next current state, NONE for internal transitions')
+    w('        uint8_t     more;   // candidate to try if the guard fails')
+    w('    };')
+    w('')
+    w('    constexpr Candidate CANDIDATES[] = {')
+    for c in t.candidates or [[0, 0, 0, NONE, NONE]]:
+        w('        { %d, %d, %d, %s, %s },' % (c[0], c[1], c[2],
+            ('STATE_' + cName(chart.states[c[3]].name)) if c[3] != NONE else 'NONE',
+            c[4] if c[4] != NONE else 'NONE'))
+    w('    };')
+    w('')
+    w('    // first candidate for each state (row) and signal (column)')
+    w('    constexpr uint8_t ROWS[STATE_COUNT][SIGNAL_COUNT] = {')
+    for s, row in zip(chart.states, t.rows):
+        w('        { %s },%s// %s' % (', '.join(str(c) if c != NONE else 'NONE' for c in row), ' ', s.name))
+    w('    };')
+    w('')
+    w('    // action ids, see %sMachine::act()' % name)
+    w('    constexpr uint8_t OPS[] = {')
+    w('        ' + (', '.join(str(o) for o in t.ops) or '0'))
+    w('    };')
+    w('')
+    w('};')
+    w('')
+    w('')
+    w('// The sketch derives its class from this one (which is templated on that')
+    w('// class) and implements the actions and guards as methods, for example:')
+    w('//     class %s : public %sMachine<%s> { ... };' % (name, name, name))
+    w('// Call start() (instead of init()) to enter the initial state.')
+    w('template <class Derived>')
+    w('class %sMachine : public TrimWright::FSM {' % name)
+    w('    protected:')
+    w('        uint8_t m_state;')
+    w('')
+    w('        void act(uint8_t action, const TrimWright::Event* event) {')
+    w('            Derived* self = static_cast<Derived*>(this);')
+    w('            switch (action) {')
+    for i, a in enumerate(t.actions, 1):
+        w('                case %d: self->%s(event); break;' % (i, a))
+    w('            }')
+    w('        }')
+    w('')
+    w('        bool guard(uint8_t guard, const TrimWright::Event* event) {')
+    w('            Derived* self = static_cast<Derived*>(this);')
+    w('            switch (guard) {')
+    for i, g in enumerate(t.guards, 1):
+        w('                case %d: return self->%s(event);' % (i, g))
+    w('            }')
+    w('            return true;')
+    w('        }')
+    w('')
+    w('    public:')
+    w('        %sMachine() : m_state(%s::NONE) {}' % (name, ns))
+    w('')
+    w('        void start() {')
+    w('            for (uint16_t op = %d; op < %d; op++) {' % t.start)
+    w('                act(%s::OPS[op], &(PSEUDOEVENTS[TrimWright::SIG_ENTER]));' % ns)
+    w('            }')
+    w('            m_state = %s::STATE_%s;' % (ns, cName(chart.states[t.startState].name)))
+    w('        }')
+    w('')
+    w('        // the current (innermost) state')
+    w('        uint8_t state() const {')
+    w('            return m_state;')
+    w('        }')
+    w('')
+    w('        // whether the state (or one of its substates) is current')
+    w('        bool isIn(uint8_t state) const {')
+    w('            for (uint8_t s = m_state; s != %s::NONE; s = %s::PARENT[s]) {' % (ns, ns))
+    w('                if (s == state) {')
+    w('                    return true;')
+    w('                }')
+    w('            }')
+    w('            return false;')
+    w('        }')
+    w('')
+    w('        virtual void dispatch(const TrimWright::Event* event) {')
+    w('            uint8_t column = uint8_t(event->signal - %s::SIGNAL_FIRST);' % ns)
+    w('            if (column >= %s::SIGNAL_COUNT || m_state == %s::NONE) {' % (ns, ns))
+    w('                return;')
+    w('            }')
+    w('            uint8_t c = %s::ROWS[m_state][column];' % ns)
+    w('            for (; c != %s::NONE; c = %s::CANDIDATES[c].more) {' % (ns, ns))
+    w('                const %s::Candidate& candidate = %s::CANDIDATES[c];' % (ns, ns))
+    w('                if (candidate.guard && !guard(candidate.guard, event)) {')
+    w('                    continue;')
+    w('                }')
+    w('                for (uint16_t op = candidate.begin; op < candidate.end; op++) {')
+    w('                    act(%s::OPS[op], event);' % ns)
+    w('                }')
+    w('                if (candidate.next != %s::NONE) {' % ns)
+    w('                    m_state = candidate.next;')
+    w('                }')
+    w('                return;')
+    w('            }')
+    w('        }')
+    w('};')
+    w('')
+    w('')
+    w('#endif')
+    return '\n'.join(out) + '\n'
+
+
+def stubs(chart):
+    t = Tables(chart)
+    name = chart.name or 'Chart'
+    out = []
+    w = out.append
+    w('class %s : public %sMachine<%s> {' % (name, name, name))
+    w('    public:')
+    for a in t.actions:
+        w('        void %s(const TrimWright::Event* event) {' % a)
+        w('        }')
+    for g in t.guards:
+        w('        bool %s(const TrimWright::Event* event) {' % g)
+        w('            return true;')
+        w('        }')
+    w('};')
+    return '\n'.join(out) + '\n'
+
+
+def main(argv):
+    args = argv[1:]
+    include = 'TrimWright.h'
+    wantStubs = False
+    while args and args[0].startswith('--'):
+        option = args.pop(0)
+        if option == '--stubs':
+            wantStubs = True
+        elif option.startswith('--include='):
+            include = option.split('=', 1)[1]
+        else:
+            args = []
+    if len(args) != 1:
+        sys.stderr.write('usage: twgen.py [--stubs] [--include=TrimWright.h] chart.{tw,scxml}\n')
+        return 2
+    source = args[0]
+    with open(source) as f:
+        text = f.read()
+    try:
+        if source.endswith('.scxml') or text.lstrip().startswith('<'):
+            chart = parseSCXML(text)
+        else:
+            chart = parseDSL(text)
+        sys.stdout.write(stubs(chart) if wantStubs else generate(chart, source, include))
+    except ChartError as e:
+        sys.stderr.write('%s: %s\n' % (source, e))
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))